@@ -0,0 +1,756 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <utility>
+#include <vector>
+#include "cunits.hpp"
+
+// Ordered storage for the disjoint intervals of the tree backend of
+// std::set<cunits<T>> (specSet.hpp).  It is a treap keyed by the lower
+// endpoint, with parent links for bidirectional iteration, and every node
+// carries totals over its subtree so that order-statistic queries run in
+// O(log n).  Split and merge keep node addresses stable, so iterators stay
+// valid until their own node is erased.
+
+template<typename T>
+class cunits_tree {
+    struct node {
+        // searches touch only the first three members
+        cunits<T> cu;
+        node *left = nullptr;
+        node *right = nullptr;
+        node *parent = nullptr;
+        uint32_t priority;
+
+        // totals over the subtree rooted here: covered units, intervals,
+        // outer bounds and the widest gap between two of its intervals
+        T measure;
+        size_t count = 1;
+        T lo;
+        T hi;
+        T max_gap{};
+
+        node(const cunits<T> &cu, uint32_t priority)
+                : cu(cu), priority(priority), measure(cu.size()), lo(cu.min()), hi(cu.max()) {
+        }
+    };
+
+    node *m_root = nullptr;
+    uint32_t m_seed = 2463534242u;
+
+    // last position of interest to the owner; cleared when its node goes.
+    // Const lookups of the owner move it, so it is a relaxed atomic:
+    // concurrent readers only disagree on where the next search starts.
+    mutable std::atomic<node *> m_finger = nullptr;
+
+    uint32_t next_priority() {
+        // xorshift32
+        m_seed ^= m_seed << 13;
+        m_seed ^= m_seed >> 17;
+        m_seed ^= m_seed << 5;
+        return m_seed;
+    }
+
+    static void prefetch(const node *n) {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(n);
+#endif
+    }
+
+    static size_t count(const node *n) {
+        return n ? n->count : 0;
+    }
+
+    static T measure(const node *n) {
+        return n ? n->measure : T{};
+    }
+
+    static void pull(node *n) {
+        n->count = 1 + count(n->left) + count(n->right);
+        n->measure = n->cu.size() + measure(n->left) + measure(n->right);
+        n->lo = n->cu.min();
+        n->hi = n->cu.max();
+        n->max_gap = T{};
+
+        if (auto l = n->left) {
+            n->lo = l->lo;
+            n->max_gap = std::max(l->max_gap, n->cu.min() - l->hi);
+        }
+        if (auto r = n->right) {
+            n->hi = r->hi;
+            n->max_gap = std::max({n->max_gap, r->max_gap, r->lo - n->cu.max()});
+        }
+    }
+
+    static void pull_all(node *n) {
+        if (n) {
+            pull_all(n->left);
+            pull_all(n->right);
+            pull(n);
+        }
+    }
+
+    static void set_left(node *p, node *c) {
+        p->left = c;
+        if (c) c->parent = p;
+    }
+
+    static void set_right(node *p, node *c) {
+        p->right = c;
+        if (c) c->parent = p;
+    }
+
+    static node *leftmost(node *n) {
+        while (n && n->left) n = n->left;
+        return n;
+    }
+
+    static node *rightmost(node *n) {
+        while (n && n->right) n = n->right;
+        return n;
+    }
+
+    static node *successor(node *n) {
+        if (n->right) {
+            return leftmost(n->right);
+        }
+        while (n->parent && n->parent->right == n) n = n->parent;
+        return n->parent;
+    }
+
+    static node *predecessor(node *n) {
+        if (n->left) {
+            return rightmost(n->left);
+        }
+        while (n->parent && n->parent->left == n) n = n->parent;
+        return n->parent;
+    }
+
+    // Splits n into the units starting before key and the rest.  The
+    // returned roots may keep stale parent links; see detach().
+    static std::pair<node *, node *> split_rec(node *n, const T &key) {
+        if (!n) {
+            return {nullptr, nullptr};
+        }
+
+        if (n->cu.min() < key) {
+            auto [l, r] = split_rec(n->right, key);
+            set_right(n, l);
+            pull(n);
+            return {n, r};
+        }
+
+        auto [l, r] = split_rec(n->left, key);
+        set_left(n, r);
+        pull(n);
+        return {l, n};
+    }
+
+    static node *detach(node *n) {
+        if (n) n->parent = nullptr;
+        return n;
+    }
+
+    static std::pair<node *, node *> split(node *n, const T &key) {
+        auto [l, r] = split_rec(n, key);
+        return {detach(l), detach(r)};
+    }
+
+    // Joins two treaps where every unit of a precedes every unit of b.
+    static node *merge(node *a, node *b) {
+        if (!a) return b;
+        if (!b) return a;
+
+        if (a->priority > b->priority) {
+            set_right(a, merge(a->right, b));
+            pull(a);
+            return a;
+        }
+
+        set_left(b, merge(a, b->left));
+        pull(b);
+        return b;
+    }
+
+    // Puts c where n hangs from its parent (or at the root).
+    void relink(node *n, node *c) {
+        auto p = n->parent;
+        if (c) c->parent = p;
+
+        if (!p) {
+            m_root = c;
+        } else if (p->left == n) {
+            p->left = c;
+        } else {
+            p->right = c;
+        }
+    }
+
+    // Lifts n above its parent.
+    void rotate_up(node *n) {
+        auto p = n->parent;
+        relink(p, n);
+
+        if (p->left == n) {
+            set_left(p, n->right);
+            set_right(n, p);
+        } else {
+            set_right(p, n->left);
+            set_left(n, p);
+        }
+
+        pull(p);
+        pull(n);
+    }
+
+    static void pull_up(node *n) {
+        for (; n; n = n->parent) pull(n);
+    }
+
+    // First unit of n starting at or after key whose gap to the next unit
+    // is at least k; after is the lower endpoint of the unit following n.
+    // Only subtrees on the search path for key can fail after passing the
+    // gap test, so this is O(log n).
+    static node *gap_after(node *n, const T &key, const T &k, const T *after) {
+        if (!n || (n->max_gap < k && (!after || *after - n->hi < k))) {
+            return nullptr;
+        }
+
+        if (n->cu.min() < key) {
+            return gap_after(n->right, key, k, after);
+        }
+
+        if (auto x = gap_after(n->left, key, k, &n->cu.min())) {
+            return x;
+        }
+
+        auto next = n->right ? &n->right->lo : after;
+        if (next && *next - n->cu.max() >= k) {
+            return n;
+        }
+
+        return gap_after(n->right, key, k, after);
+    }
+
+    // Mirror image of gap_after(): last unit of n starting at or before
+    // key whose gap to the previous unit is at least k.
+    static node *gap_before(node *n, const T &key, const T &k, const T *before) {
+        if (!n || (n->max_gap < k && (!before || n->lo - *before < k))) {
+            return nullptr;
+        }
+
+        if (key < n->cu.min()) {
+            return gap_before(n->left, key, k, before);
+        }
+
+        if (auto y = gap_before(n->right, key, k, &n->cu.max())) {
+            return y;
+        }
+
+        auto prev = n->left ? &n->left->hi : before;
+        if (prev && n->cu.min() - *prev >= k) {
+            return n;
+        }
+
+        return gap_before(n->left, key, k, before);
+    }
+
+    void destroy(node *n) {
+        if (n) {
+            destroy(n->left);
+            destroy(n->right);
+            dispose(n);
+        }
+    }
+
+    void dispose(node *n) {
+        if (n == m_finger.load(std::memory_order_relaxed)) {
+            m_finger.store(nullptr, std::memory_order_relaxed);
+        }
+        delete n;
+    }
+
+    static node *clone(const node *n, node *parent) {
+        if (!n) {
+            return nullptr;
+        }
+
+        auto copy = new node(*n);
+        copy->parent = parent;
+        copy->left = clone(n->left, copy);
+        copy->right = clone(n->right, copy);
+        return copy;
+    }
+
+    // Builds a treap from sorted, disjoint units in O(k) by keeping the
+    // right spine on a stack.
+    template<typename It>
+    node *build(It first, It last) {
+        std::vector<node *> spine;
+
+        for (; first != last; ++first) {
+            auto n = new node(*first, next_priority());
+            node *below = nullptr;
+
+            while (!spine.empty() && spine.back()->priority < n->priority) {
+                below = spine.back();
+                spine.pop_back();
+            }
+
+            set_left(n, below);
+            if (!spine.empty()) {
+                set_right(spine.back(), n);
+            }
+            spine.push_back(n);
+        }
+
+        if (spine.empty()) {
+            return nullptr;
+        }
+
+        pull_all(spine.front());
+        return detach(spine.front());
+    }
+
+public:
+    class iterator {
+        friend class cunits_tree;
+
+        const cunits_tree *m_tree = nullptr;
+        node *m_node = nullptr;
+
+        iterator(const cunits_tree *tree, node *n) : m_tree(tree), m_node(n) {
+        }
+
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = cunits<T>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const cunits<T> *;
+        using reference = const cunits<T> &;
+
+        iterator() = default;
+
+        reference operator*() const {
+            return m_node->cu;
+        }
+
+        pointer operator->() const {
+            return &m_node->cu;
+        }
+
+        iterator &operator++() {
+            m_node = successor(m_node);
+            return *this;
+        }
+
+        iterator operator++(int) {
+            auto old = *this;
+            ++*this;
+            return old;
+        }
+
+        iterator &operator--() {
+            m_node = m_node ? predecessor(m_node) : rightmost(m_tree->m_root);
+            return *this;
+        }
+
+        iterator operator--(int) {
+            auto old = *this;
+            --*this;
+            return old;
+        }
+
+        bool operator==(const iterator &rhs) const {
+            return m_node == rhs.m_node;
+        }
+    };
+
+    using const_iterator = iterator;
+
+    // ============================= CONSTRUCTORS =============================
+
+    cunits_tree() = default;
+
+    // Draws priorities from the given non-zero seed; trees that will be
+    // joined need different seeds to stay balanced.
+    explicit cunits_tree(uint32_t seed) : m_seed(seed) {
+        assert(seed);
+    }
+
+    cunits_tree(const cunits_tree &other) : m_root(clone(other.m_root, nullptr)), m_seed(other.m_seed) {
+    }
+
+    cunits_tree(cunits_tree &&other) noexcept
+            : m_root(std::exchange(other.m_root, nullptr)), m_seed(other.m_seed),
+              m_finger(other.m_finger.exchange(nullptr, std::memory_order_relaxed)) {
+    }
+
+    cunits_tree &operator=(cunits_tree other) noexcept {
+        std::swap(m_root, other.m_root);
+        std::swap(m_seed, other.m_seed);
+        other.m_finger.store(m_finger.exchange(other.m_finger.load(std::memory_order_relaxed),
+                                               std::memory_order_relaxed), std::memory_order_relaxed);
+        return *this;
+    }
+
+    ~cunits_tree() {
+        destroy(m_root);
+    }
+
+    // ============================= ITERATORS =============================
+
+    iterator begin() const {
+        return {this, leftmost(m_root)};
+    }
+
+    iterator end() const {
+        return {this, nullptr};
+    }
+
+    // ============================= CAPACITY =============================
+
+    [[nodiscard]] bool empty() const {
+        return !m_root;
+    }
+
+    size_t size() const {
+        return count(m_root);
+    }
+
+    // Total number of covered units.
+    T measure() const {
+        return measure(m_root);
+    }
+
+    // Number of covered units below x.
+    T measure_below(const T &x) const {
+        T result{};
+
+        for (auto n = m_root; n;) {
+            if (x <= n->cu.min()) {
+                n = n->left;
+                continue;
+            }
+
+            result += measure(n->left) + (std::min(x, n->cu.max()) - n->cu.min());
+            if (x <= n->cu.max()) {
+                break;
+            }
+            n = n->right;
+        }
+
+        return result;
+    }
+
+    // The k-th covered unit, counting from 0; k must be below measure().
+    T value_at(T k) const {
+        assert(k < measure());
+
+        for (auto n = m_root;;) {
+            if (k < measure(n->left)) {
+                n = n->left;
+                continue;
+            }
+
+            k -= measure(n->left);
+            if (k < n->cu.size()) {
+                return n->cu.min() + k;
+            }
+
+            k -= n->cu.size();
+            n = n->right;
+        }
+    }
+
+    // The k-th unit in order, counting from 0; k must be below size().
+    iterator nth(size_t k) const {
+        assert(k < size());
+
+        for (auto n = m_root;;) {
+            if (k < count(n->left)) {
+                n = n->left;
+            } else if (k == count(n->left)) {
+                return {this, n};
+            } else {
+                k -= count(n->left) + 1;
+                n = n->right;
+            }
+        }
+    }
+
+    // Number of units before pos; size() for end().
+    size_t position(iterator pos) const {
+        auto n = pos.m_node;
+        if (!n) {
+            return size();
+        }
+
+        auto result = count(n->left);
+        for (; n->parent; n = n->parent) {
+            if (n->parent->right == n) {
+                result += count(n->parent->left) + 1;
+            }
+        }
+        return result;
+    }
+
+    // The unit ending the gap that holds the k-th uncovered unit after the
+    // first unit, counting from 0; k must be below the uncovered units
+    // between the first and the last unit.
+    iterator gap_select(T k) const {
+        assert(m_root);
+
+        node *result = nullptr;
+        T first = m_root->lo;
+        T covered{};
+
+        for (auto n = m_root; n;) {
+            auto before = covered + measure(n->left);
+            if (k < n->cu.min() - first - before) {
+                result = n;
+                n = n->left;
+            } else {
+                covered = before + n->cu.size();
+                n = n->right;
+            }
+        }
+
+        return {this, result};
+    }
+
+    // First unit starting at or after key that is followed by a gap of at
+    // least k units before the next one.
+    iterator gap_after(const T &key, const T &k) const {
+        return {this, gap_after(m_root, key, k, nullptr)};
+    }
+
+    // Last unit starting at or before key that is preceded by a gap of at
+    // least k units after the previous one.
+    iterator gap_before(const T &key, const T &k) const {
+        return {this, gap_before(m_root, key, k, nullptr)};
+    }
+
+    // ============================= MODIFIERS =============================
+
+    void clear() {
+        destroy(std::exchange(m_root, nullptr));
+    }
+
+    // Inserts cu, which must not overlap any stored unit, right before pos,
+    // the first unit starting after it, as a leaf hung from pos (or from
+    // the last unit for end()) and rotates it up to restore the heap order.
+    // Placing the leaf takes no search from the root, but refreshing the
+    // subtree totals still walks up to it, so this is O(log n).
+    iterator insert(iterator pos, const cunits<T> &cu) {
+        assert(pos == end() || cu.max() <= pos->min());
+        assert(pos == begin() || std::prev(pos)->max() <= cu.min());
+
+        auto n = new node(cu, next_priority());
+
+        if (!m_root) {
+            m_root = n;
+            return {this, n};
+        }
+
+        if (!pos.m_node) {
+            set_right(rightmost(m_root), n);
+        } else if (!pos.m_node->left) {
+            set_left(pos.m_node, n);
+        } else {
+            set_right(rightmost(pos.m_node->left), n);
+        }
+
+        while (n->parent && n->parent->priority < n->priority) {
+            rotate_up(n);
+        }
+
+        pull_up(n->parent);
+        return {this, n};
+    }
+
+    // Appends sorted, disjoint units that all follow the stored ones.
+    template<typename It>
+    void insert(It first, It last) {
+        assert(first == last || empty() || rightmost(m_root)->cu.max() <= first->min());
+        m_root = detach(merge(m_root, build(first, last)));
+    }
+
+    // Moves the units of other, which must all follow the stored ones,
+    // to the end of this tree in expected O(log n).
+    void join(cunits_tree &&other) {
+        assert(empty() || other.empty() || rightmost(m_root)->cu.max() <= leftmost(other.m_root)->cu.min());
+        m_root = detach(merge(m_root, std::exchange(other.m_root, nullptr)));
+        other.m_finger.store(nullptr, std::memory_order_relaxed);
+    }
+
+    // Overwrites the unit at pos; the order of units must not change.
+    void replace(iterator pos, const cunits<T> &cu) {
+        pos.m_node->cu = cu;
+        pull_up(pos.m_node);
+    }
+
+    // Removes [first, last) in O(log n + k).
+    iterator erase(iterator first, iterator last) {
+        if (first == last) {
+            return last;
+        }
+
+        if (std::next(first) == last) {
+            return erase(first);
+        }
+
+        auto [l, rest] = split(m_root, first->min());
+        node *erased = rest;
+
+        if (last != end()) {
+            auto [mid, r] = split(rest, last->min());
+            erased = mid;
+            rest = r;
+        } else {
+            rest = nullptr;
+        }
+
+        destroy(erased);
+        m_root = detach(merge(l, rest));
+        return last;
+    }
+
+    iterator erase(iterator pos) {
+        auto n = pos.m_node;
+        auto next = std::next(pos);
+
+        relink(n, merge(n->left, n->right));
+        pull_up(n->parent);
+        dispose(n);
+        return next;
+    }
+
+    // ============================= LOOKUP =============================
+
+    // Last unit that begins at or before x.
+    iterator floor(const T &x) const {
+        node *result = nullptr;
+
+        for (auto n = m_root; n;) {
+            if (n->cu.min() <= x) {
+                result = n;
+                n = n->right;
+            } else {
+                n = n->left;
+            }
+        }
+
+        return {this, result};
+    }
+
+    // floor() of every x in xs, descending for lanes of them at a time in
+    // lockstep so that their cache misses overlap.
+    template<size_t lanes>
+    void floor_many(std::span<const T> xs, std::span<iterator> result) const {
+        node *cur[lanes];
+        node *best[lanes];
+
+        for (size_t q0 = 0; q0 < xs.size(); q0 += lanes) {
+            size_t width = std::min(lanes, xs.size() - q0);
+            auto x = xs.subspan(q0, width);
+            std::fill_n(cur, width, m_root);
+            std::fill_n(best, width, nullptr);
+
+            for (bool active = m_root; active;) {
+                active = false;
+                for (size_t g = 0; g < width; ++g) {
+                    if (auto n = cur[g]) {
+                        if (n->cu.min() <= x[g]) {
+                            best[g] = n;
+                            n = n->right;
+                        } else {
+                            n = n->left;
+                        }
+
+                        if ((cur[g] = n)) {
+                            prefetch(n);
+                            active = true;
+                        }
+                    }
+                }
+            }
+
+            for (size_t g = 0; g < width; ++g) {
+                result[q0 + g] = {this, best[g]};
+            }
+        }
+    }
+
+    iterator finger() const {
+        return {this, m_finger.load(std::memory_order_relaxed)};
+    }
+
+    void set_finger(iterator pos) const {
+        m_finger.store(pos.m_node, std::memory_order_relaxed);
+    }
+
+    // First unit that ends after v, searched from hint (end() starts
+    // from the last unit): climb until the subtree spans v, then descend.
+    // Expected O(log d) in the distance d between hint and the result.
+    iterator lower_bound(iterator hint, const T &v) const {
+        auto n = hint.m_node ? hint.m_node : rightmost(m_root);
+        if (!n) {
+            return end();
+        }
+
+        while (n->parent && !(n->lo <= v && v < n->hi)) {
+            n = n->parent;
+        }
+
+        node *result = nullptr;
+        while (n) {
+            if (v < n->cu.max()) {
+                result = n;
+                n = n->left;
+            } else {
+                n = n->right;
+            }
+        }
+
+        return {this, result};
+    }
+
+    // First unit that ends after cu begins.
+    iterator lower_bound(const cunits<T> &cu) const {
+        node *result = nullptr;
+
+        for (auto n = m_root; n;) {
+            if (cu.min() < n->cu.max()) {
+                result = n;
+                n = n->left;
+            } else {
+                n = n->right;
+            }
+        }
+
+        return {this, result};
+    }
+
+    // First unit that begins at or after the end of cu.
+    iterator upper_bound(const cunits<T> &cu) const {
+        node *result = nullptr;
+
+        for (auto n = m_root; n;) {
+            if (cu.max() <= n->cu.min()) {
+                result = n;
+                n = n->left;
+            } else {
+                n = n->right;
+            }
+        }
+
+        return {this, result};
+    }
+};
@@ -144,6 +144,25 @@ void test() {
     std::cout <<  "Found: " << found << '\n';
     std::cout <<  "Time: " << duration << " ms\n\n";
 
+    // searching again, with the presence summary rejecting most misses
+    range.enable_summary(4);
+    found = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for(auto number: numbers) {
+        auto it = range.find(number);
+        if (it != range.end()) {
+            found++;
+        }
+    }
+    end = std::chrono::high_resolution_clock::now();
+    duration = std::chrono::duration_cast<std::chrono::milliseconds>( end - start).count();
+    range.disable_summary();
+
+    std::cout << "SPECIALIZATION SEARCHING TIME WITH SUMMARY\n";
+    std::cout << "==========================================================\n";
+    std::cout <<  "Found: " << found << '\n';
+    std::cout <<  "Time: " << duration << " ms\n\n";
+
     // SET DELETION TIME
     start = std::chrono::high_resolution_clock::now();
     for (auto item: to_insert) {
@@ -156,6 +175,8 @@ void test() {
     std::cout << "==========================================================\n";
     std::cout << "Time: " << duration << " ms\n\n";
 
+    auto batch = range;
+
     // SPECIALIZATION DELETION TIME
     start = std::chrono::high_resolution_clock::now();
     for (auto item: to_insert) {
@@ -168,6 +189,18 @@ void test() {
     std::cout << "==========================================================\n";
     std::cout << "Time: " << duration << " ms\n\n";
 
+    // SPECIALIZATION BATCH DELETION TIME
+    std::vector<int> values(to_insert.begin(), to_insert.end());
+    start = std::chrono::high_resolution_clock::now();
+    batch.erase_values(values);
+    end = std::chrono::high_resolution_clock::now();
+    duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+    std::cout << "SPECIALIZATION BATCH DELETION TIME\n";
+    std::cout << "==========================================================\n";
+    std::cout << "Remaining: " << batch.size() << '\n';
+    std::cout << "Time: " << duration << " ms\n\n";
+
     set.clear();
     range.clear();
 
@@ -179,6 +212,117 @@ void test() {
         print_found<std::set>(range, numbers);
 }
 
+void batch_search() {
+    std::set<cunits<int>> range{};
+    Rand random{};
+
+    // ============================= CONFIG =============================
+    const int NUM_OF_CUNITS = 4000000;
+    const int MAX_SINGLE_CUNIT_SIZE = 3;
+
+    const int NUM_OF_NUMBERS_TO_FIND = 1000000;
+    const int MAX_RANDOM_NUMBER_TO_FIND = NUM_OF_CUNITS * 4;
+    // =============================--------=============================
+
+    // a set far larger than the caches, so that every search misses
+    for (int i = 0; i < NUM_OF_CUNITS; ++i) {
+        range.append({i * 4, i * 4 + random.get(1, MAX_SINGLE_CUNIT_SIZE)});
+    }
+
+    std::vector<int> numbers{};
+    for (int i = 0; i < NUM_OF_NUMBERS_TO_FIND; ++i) {
+        numbers.push_back(random.get(0, MAX_RANDOM_NUMBER_TO_FIND));
+    }
+
+    // one search after another
+    int found{};
+    auto start = std::chrono::high_resolution_clock::now();
+    for (auto number: numbers) {
+        if (range.find(number) != range.end()) {
+            found++;
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+    std::cout << "SPECIALIZATION SEARCHING TIME (LARGE SET)\n";
+    std::cout << "==========================================================\n";
+    std::cout <<  "Found: " << found << '\n';
+    std::cout <<  "Time: " << duration << " ms\n\n";
+
+    // interleaved searches
+    std::vector<decltype(range.end())> results(numbers.size());
+    start = std::chrono::high_resolution_clock::now();
+    range.find_many(numbers, results);
+    found = std::ranges::count_if(results, [&](auto it) { return it != range.end(); });
+    end = std::chrono::high_resolution_clock::now();
+    duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+    std::cout << "SPECIALIZATION BATCH SEARCHING TIME (LARGE SET)\n";
+    std::cout << "==========================================================\n";
+    std::cout <<  "Found: " << found << '\n';
+    std::cout <<  "Time: " << duration << " ms\n\n";
+}
+
+void parallel_algebra() {
+    std::set<cunits<int>> lhs{};
+    std::set<cunits<int>> rhs{};
+    Rand random{};
+
+    // ============================= CONFIG =============================
+    const int NUM_OF_CUNITS = 10000000;
+    const int REPETITIONS = 5;
+    // =============================--------=============================
+
+    for (int i = 0; i < NUM_OF_CUNITS; ++i) {
+        lhs.append({i * 10, i * 10 + random.get(1, 8)});
+        rhs.append({i * 10 + random.get(0, 5), i * 10 + 9});
+    }
+
+    // best of a few runs, in milliseconds
+    auto time = [&](auto operation) {
+        double best = 0;
+        for (int r = 0; r < REPETITIONS; ++r) {
+            auto start = std::chrono::high_resolution_clock::now();
+            auto result = operation();
+            auto end = std::chrono::high_resolution_clock::now();
+            double duration = std::chrono::duration<double, std::milli>(end - start).count();
+            best = r ? std::min(best, duration) : duration;
+            if (result.empty()) {
+                std::cout << "empty result\n";
+            }
+        }
+        return best;
+    };
+
+    std::vector<unsigned> thread_counts{};
+    for (unsigned threads = 1; threads < std::thread::hardware_concurrency(); threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(std::max(1u, std::thread::hardware_concurrency()));
+
+    auto report = [&](const char *name, auto sequential, auto parallel) {
+        double base = time(sequential);
+
+        std::cout << "PARALLEL " << name << " TIME (" << NUM_OF_CUNITS << " CUNITS EACH)\n";
+        std::cout << "==========================================================\n";
+        std::cout << "Sequential: " << base << " ms\n";
+        for (auto threads: thread_counts) {
+            double duration = time([&] { return parallel(threads); });
+            std::cout << "Threads: " << threads << " || Time: " << duration << " ms || Speedup: "
+                      << base / duration << "x\n";
+        }
+        std::cout << '\n';
+    };
+
+    report("INTERSECTION", [&] { return std::intersection(lhs, rhs); },
+           [&](unsigned threads) { return std::intersection(lhs, rhs, std::launch::async, threads); });
+    report("UNION", [&] { return std::union_of(lhs, rhs); },
+           [&](unsigned threads) { return std::union_of(lhs, rhs, std::launch::async, threads); });
+    report("DIFFERENCE", [&] { return std::difference(lhs, rhs); },
+           [&](unsigned threads) { return std::difference(lhs, rhs, std::launch::async, threads); });
+}
+
 void generator() {
     std::set<cunits<int>> range{};
     range.insert({1, 3});
@@ -201,4 +345,6 @@ void generator() {
 int main() {
 
     test();
+    batch_search();
+    parallel_algebra();
 }
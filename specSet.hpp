@@ -4,10 +4,574 @@
 #include <vector>
 #include <numeric>
 #include <initializer_list>
+#include <iterator>
 #include <algorithm>
+#include <future>
+#include <ranges>
+#include <span>
+#include <thread>
+#include <optional>
+#include <limits>
+#include <cstdint>
+#include <cmath>
+#include <random>
 #include "cunits.hpp"
+#include "cunitsTree.hpp"
 
 namespace std {
+    namespace cunits_detail {
+        // Sets whose sizes differ by more than this factor are merged by
+        // galloping through the larger one instead of walking it linearly.
+        inline constexpr size_t gallop_ratio = 8;
+
+        // Fan-ins up to this many sets are reduced in a single sweep.
+        inline constexpr size_t reduction_leaf = 8;
+
+        inline bool skewed(size_t small, size_t large) {
+            return small * gallop_ratio < large;
+        }
+
+        // Unsorted lookups run this many searches side by side so that
+        // their cache misses overlap.
+        inline constexpr size_t lookup_lanes = 16;
+
+        // Gap sampling gives up drawing after this many draws land in gaps
+        // that are too small, and lists the candidates instead.
+        inline constexpr int sample_attempts = 16;
+
+        // Keeps the k largest of the units offered to it, the lowest first
+        // among equals, in a heap whose top is the worst one kept.
+        template<typename T>
+        class top_k {
+            size_t m_k;
+            vector<cunits<T>> m_heap;
+
+            static bool better(const cunits<T> &a, const cunits<T> &b) {
+                return a.size() != b.size() ? a.size() > b.size() : a.min() < b.min();
+            }
+
+        public:
+            explicit top_k(size_t k) : m_k(k) {
+            }
+
+            bool full() const {
+                return m_heap.size() == m_k;
+            }
+
+            // The smallest size kept; only meaningful once full().
+            T worst() const {
+                return m_heap.front().size();
+            }
+
+            void offer(const cunits<T> &cu) {
+                if (m_heap.size() < m_k) {
+                    m_heap.push_back(cu);
+                    push_heap(m_heap.begin(), m_heap.end(), better);
+                } else if (m_k && better(cu, m_heap.front())) {
+                    pop_heap(m_heap.begin(), m_heap.end(), better);
+                    m_heap.back() = cu;
+                    push_heap(m_heap.begin(), m_heap.end(), better);
+                }
+            }
+
+            // The kept units, best first.
+            vector<cunits<T>> take() && {
+                sort_heap(m_heap.begin(), m_heap.end(), better);
+                return std::move(m_heap);
+            }
+        };
+
+        // Covered units below ascending keys x, counted from the interval
+        // the cursor starts at, so only differences between answers mean
+        // anything.  Each call moves past the intervals ending by x, making
+        // a run of calls one linear sweep.
+        template<typename It, typename T>
+        class measure_cursor {
+            It m_i;
+            It m_last;
+            T m_before{};
+
+        public:
+            measure_cursor(It first, It last) : m_i(first), m_last(last) {
+            }
+
+            T operator()(const T &x) {
+                while (m_i != m_last && m_i->max() <= x) {
+                    m_before += m_i->size();
+                    ++m_i;
+                }
+                return m_i != m_last && m_i->min() < x ? m_before + (x - m_i->min()) : m_before;
+            }
+        };
+
+        // Defined with the other set algebra kernels below.
+        template<typename L, typename R, typename Out>
+        void union_into(const L &lhs, const R &rhs, Out &out);
+
+        // Defined with the parallel set algebra below.
+        template<typename T, typename Kernel>
+        set<cunits<T>> partitioned(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs, launch policy,
+                                   size_t threads, Kernel kernel);
+
+        // Sorts units by lower endpoint and merges the ones that overlap or
+        // touch, dropping empty ones, in place.
+        template<typename T>
+        void coalesce(vector<cunits<T>> &units) {
+            erase_if(units, [](const cunits<T> &cu) { return cu.empty(); });
+            ranges::sort(units, {}, [](const cunits<T> &cu) { return cu.min(); });
+
+            size_t n = 0;
+            for (const auto &cu: units) {
+                if (n && cu.min() <= units[n - 1].max()) {
+                    units[n - 1] = cunits<T>(units[n - 1].min(), std::max(units[n - 1].max(), cu.max()));
+                } else {
+                    units[n++] = cu;
+                }
+            }
+            units.resize(n);
+        }
+
+        // A uniformly random value in [0, n).
+        template<typename T, typename R>
+        T draw(R &rng, const T &n) {
+            if constexpr (is_integral_v<T>) {
+                return uniform_int_distribution<T>(0, n - 1)(rng);
+            } else {
+                return uniform_real_distribution<T>(0, n)(rng);
+            }
+        }
+
+        // One bit per block of 2^shift consecutive values, set when some
+        // value of the block is covered, so that a clear bit proves a miss
+        // without touching the intervals.  The bits span the blocks between
+        // the lowest and highest ever covered, 2^shift values per bit.
+        template<typename T>
+        class presence_summary {
+            unsigned m_shift;
+            int64_t m_first = 0;
+            vector<uint64_t> m_words;
+
+        public:
+            explicit presence_summary(unsigned shift) : m_shift(shift) {
+            }
+
+            int64_t block(const T &v) const {
+                if constexpr (is_integral_v<T>) {
+                    return static_cast<int64_t>(v >> m_shift);
+                } else {
+                    return static_cast<int64_t>(floor(ldexp(v, -static_cast<int>(m_shift))));
+                }
+            }
+
+            T block_start(int64_t b) const {
+                if constexpr (is_integral_v<T>) {
+                    return static_cast<T>(b) << m_shift;
+                } else {
+                    return ldexp(static_cast<T>(b), static_cast<int>(m_shift));
+                }
+            }
+
+            bool test(const T &v) const {
+                auto b = block(v) - m_first;
+                return b >= 0 && b < static_cast<int64_t>(m_words.size()) * 64 && (m_words[b / 64] >> b % 64 & 1);
+            }
+
+            // Sets or clears the bits of blocks [first, last].
+            void assign(int64_t first, int64_t last, bool on) {
+                if (on) {
+                    reserve(first, last);
+                } else {
+                    first = std::max(first, m_first);
+                    last = std::min(last, m_first + static_cast<int64_t>(m_words.size()) * 64 - 1);
+                }
+
+                for (auto b = first; b <= last;) {
+                    auto word = (b - m_first) / 64;
+                    auto from = (b - m_first) % 64;
+                    auto to = std::min<int64_t>(63, from + (last - b));
+                    auto mask = (~uint64_t(0) >> (63 - to)) & (~uint64_t(0) << from);
+                    m_words[word] = on ? m_words[word] | mask : m_words[word] & ~mask;
+                    b += to - from + 1;
+                }
+            }
+
+            void clear() {
+                m_words.clear();
+            }
+
+        private:
+            // Grows the bits to span blocks [first, last], keeping m_first a
+            // multiple of 64 so that growing at the front moves whole words.
+            void reserve(int64_t first, int64_t last) {
+                if (m_words.empty()) {
+                    m_first = first >> 6 << 6;
+                }
+                if (first < m_first) {
+                    auto grow = (m_first - (first >> 6 << 6)) / 64;
+                    m_words.insert(m_words.begin(), grow, 0);
+                    m_first -= grow * 64;
+                }
+                if (auto words = (last - m_first) / 64 + 1; words > static_cast<int64_t>(m_words.size())) {
+                    m_words.resize(words);
+                }
+            }
+        };
+
+        // Returns the first interval in [from, s.end()) that ends after v.
+        // With gallop set, the skipped run is found by a search from the
+        // root in O(log n); otherwise by a linear walk.
+        template<typename S, typename It, typename V>
+        It seek_past(const S &s, It from, const V &v, bool gallop) {
+            if (!gallop) {
+                while (from != s.end() && from->max() <= v) {
+                    ++from;
+                }
+                return from;
+            }
+
+            if (from == s.end() || v < from->max()) {
+                return from;
+            }
+            return s.lower_bound({v, v});
+        }
+
+        // Samples parts - 1 partition boundaries from the intervals of tree,
+        // evenly spaced by position; the outer bounds are left for the
+        // caller to fill in.
+        template<typename T>
+        vector<T> sample_bounds(const cunits_tree<T> &tree, size_t parts) {
+            vector<T> bounds(parts + 1);
+            for (size_t p = 1; p < parts; ++p) {
+                bounds[p] = tree.nth(tree.size() * p / parts)->min();
+            }
+            return bounds;
+        }
+
+        // ============================= LAZY EXPRESSIONS =============================
+
+        // A cursor streams the sorted, disjoint units of a set or of a set
+        // expression: front() is the current unit and pop() moves past it.
+        // Composite cursors compute the next unit of the result eagerly, so
+        // pop() is where the work happens.
+
+        template<typename It>
+        class set_cursor {
+            It m_cur;
+            It m_last;
+
+        public:
+            set_cursor(It first, It last) : m_cur(first), m_last(last) {
+            }
+
+            bool valid() const {
+                return m_cur != m_last;
+            }
+
+            auto front() const {
+                return *m_cur;
+            }
+
+            void pop() {
+                ++m_cur;
+            }
+        };
+
+        template<typename L, typename R>
+        class intersection_cursor {
+            L m_lhs;
+            R m_rhs;
+            decltype(m_lhs.front()) m_front;
+            bool m_valid = false;
+
+            void settle() {
+                while (m_lhs.valid() && m_rhs.valid()) {
+                    auto i = m_lhs.front();
+                    auto j = m_rhs.front();
+
+                    if (i.max() <= j.min()) {
+                        m_lhs.pop();
+                        continue;
+                    }
+
+                    if (j.max() <= i.min()) {
+                        m_rhs.pop();
+                        continue;
+                    }
+
+                    m_front = {std::max(i.min(), j.min()), std::min(i.max(), j.max())};
+                    m_valid = true;
+
+                    if (i.max() < j.max()) {
+                        m_lhs.pop();
+                    } else {
+                        m_rhs.pop();
+                    }
+                    return;
+                }
+
+                m_valid = false;
+            }
+
+        public:
+            intersection_cursor(L lhs, R rhs) : m_lhs(std::move(lhs)), m_rhs(std::move(rhs)) {
+                settle();
+            }
+
+            bool valid() const {
+                return m_valid;
+            }
+
+            auto front() const {
+                return m_front;
+            }
+
+            void pop() {
+                settle();
+            }
+        };
+
+        template<typename L, typename R>
+        class union_cursor {
+            L m_lhs;
+            R m_rhs;
+            decltype(m_lhs.front()) m_front;
+            bool m_valid = false;
+
+            void settle() {
+                if (!m_lhs.valid() && !m_rhs.valid()) {
+                    m_valid = false;
+                    return;
+                }
+
+                auto take = [](auto &cursor) {
+                    auto cu = cursor.front();
+                    cursor.pop();
+                    return cu;
+                };
+
+                bool left = !m_rhs.valid() || (m_lhs.valid() && m_lhs.front().min() < m_rhs.front().min());
+                auto cu = left ? take(m_lhs) : take(m_rhs);
+                auto max = cu.max();
+
+                // swallow everything overlapping or touching the unit
+                for (bool grown = true; grown;) {
+                    grown = false;
+                    if (m_lhs.valid() && m_lhs.front().min() <= max) {
+                        max = std::max(max, take(m_lhs).max());
+                        grown = true;
+                    }
+                    if (m_rhs.valid() && m_rhs.front().min() <= max) {
+                        max = std::max(max, take(m_rhs).max());
+                        grown = true;
+                    }
+                }
+
+                m_front = {cu.min(), max};
+                m_valid = true;
+            }
+
+        public:
+            union_cursor(L lhs, R rhs) : m_lhs(std::move(lhs)), m_rhs(std::move(rhs)) {
+                settle();
+            }
+
+            bool valid() const {
+                return m_valid;
+            }
+
+            auto front() const {
+                return m_front;
+            }
+
+            void pop() {
+                settle();
+            }
+        };
+
+        template<typename L, typename R>
+        class difference_cursor {
+            L m_lhs;
+            R m_rhs;
+            decltype(m_lhs.front()) m_front;
+            bool m_valid = false;
+
+            // the front of lhs has been cut and continues from m_lo
+            bool m_cut = false;
+            remove_cvref_t<decltype(m_front.min())> m_lo{};
+
+            void settle() {
+                while (m_lhs.valid()) {
+                    auto i = m_lhs.front();
+                    auto lo = m_cut ? m_lo : i.min();
+
+                    while (m_rhs.valid() && m_rhs.front().max() <= lo) {
+                        m_rhs.pop();
+                    }
+
+                    if (!m_rhs.valid() || i.max() <= m_rhs.front().min()) {
+                        m_front = {lo, i.max()};
+                        m_valid = true;
+                        m_cut = false;
+                        m_lhs.pop();
+                        return;
+                    }
+
+                    auto j = m_rhs.front();
+
+                    if (j.max() < i.max()) {
+                        m_cut = true;
+                        m_lo = j.max();
+                    } else {
+                        m_cut = false;
+                        m_lhs.pop();
+                    }
+
+                    if (lo < j.min()) {
+                        m_front = {lo, j.min()};
+                        m_valid = true;
+                        return;
+                    }
+                }
+
+                m_valid = false;
+            }
+
+        public:
+            difference_cursor(L lhs, R rhs) : m_lhs(std::move(lhs)), m_rhs(std::move(rhs)) {
+                settle();
+            }
+
+            bool valid() const {
+                return m_valid;
+            }
+
+            auto front() const {
+                return m_front;
+            }
+
+            void pop() {
+                settle();
+            }
+        };
+
+        // A set operand of an expression, held by reference.
+        template<typename S>
+        struct set_operand {
+            const S *m_set;
+
+            auto cursor() const {
+                return set_cursor(m_set->begin(), m_set->end());
+            }
+        };
+
+        // A temporary set operand, moved into the expression so that it
+        // lives as long as the expression does.
+        template<typename S>
+        struct owned_set_operand {
+            S m_set;
+
+            auto cursor() const {
+                return set_cursor(m_set.begin(), m_set.end());
+            }
+        };
+
+        // A lazily evaluated combination of two operands.  Nothing is
+        // computed until the expression is iterated, counted, queried or
+        // converted to a set; each evaluation reads every input once in a
+        // single fused sweep and allocates nothing.  Like a view, it refers
+        // to the named sets it was built from and must not outlive them;
+        // temporary sets are kept inside it.
+        template<template<typename, typename> typename Cursor, typename L, typename R>
+        class expression {
+            L m_lhs;
+            R m_rhs;
+
+        public:
+            expression(L lhs, R rhs) : m_lhs(std::move(lhs)), m_rhs(std::move(rhs)) {
+            }
+
+            auto cursor() const {
+                return Cursor(m_lhs.cursor(), m_rhs.cursor());
+            }
+
+            using cursor_type = decltype(declval<const expression &>().cursor());
+            using data_type = decltype(declval<cursor_type>().front());
+            using value_type = remove_cvref_t<decltype(declval<data_type>().min())>;
+
+            class iterator {
+                cursor_type m_cursor;
+
+            public:
+                using value_type = expression::data_type;
+                using difference_type = ptrdiff_t;
+
+                explicit iterator(cursor_type cursor) : m_cursor(std::move(cursor)) {
+                }
+
+                value_type operator*() const {
+                    return m_cursor.front();
+                }
+
+                iterator &operator++() {
+                    m_cursor.pop();
+                    return *this;
+                }
+
+                void operator++(int) {
+                    m_cursor.pop();
+                }
+
+                bool operator==(default_sentinel_t) const {
+                    return !m_cursor.valid();
+                }
+            };
+
+            iterator begin() const {
+                return iterator(cursor());
+            }
+
+            default_sentinel_t end() const {
+                return default_sentinel;
+            }
+
+            [[nodiscard]] bool empty() const {
+                return !cursor().valid();
+            }
+
+            size_t size() const {
+                size_t result = 0;
+                for (auto c = cursor(); c.valid(); c.pop()) {
+                    ++result;
+                }
+                return result;
+            }
+
+            bool contains(const data_type &cu) const {
+                for (auto c = cursor(); c.valid(); c.pop()) {
+                    if (cu.min() < c.front().max()) {
+                        return c.front().includes(cu);
+                    }
+                }
+                return false;
+            }
+
+            bool contains(const value_type &value) const {
+                for (auto c = cursor(); c.valid(); c.pop()) {
+                    if (value < c.front().max()) {
+                        return c.front().contains(value);
+                    }
+                }
+                return false;
+            }
+        };
+
+        template<typename X>
+        inline constexpr bool is_expression = false;
+
+        template<template<typename, typename> typename Cursor, typename L, typename R>
+        inline constexpr bool is_expression<expression<Cursor, L, R>> = true;
+    }
+
     template<typename T>
     class set<cunits<T>> {
     private:
@@ -15,14 +579,299 @@ namespace std {
         using size_type = T;
         using value_type = T;
 
-        struct data_type_cmp {
-            bool operator()(const data_type &lhs, const data_type &rhs) const {
-                return lhs.max() <= rhs.min();
+        // ordered by lhs.max() <= rhs.min(), with subtree totals
+        using adapted_type = cunits_tree<T>;
+        adapted_type m_cus;
+
+        // First interval at or after a followed by a gap of at least k.
+        auto gap_after(typename adapted_type::iterator a, const T &k) const {
+            return m_cus.gap_after(a->min(), k);
+        }
+
+        // Last interval at or before b preceded by a gap of at least k.
+        auto gap_before(typename adapted_type::iterator b, const T &k) const {
+            return m_cus.gap_before(b->min(), k);
+        }
+
+        // gaps between neighbouring intervals as (size, lower endpoint),
+        // kept only after enable_gap_index()
+        optional<set<pair<T, T>>> m_gap_index;
+
+        // Adds to or drops from the gap index every gap touching region,
+        // which are the only gaps a modification of region can change.
+        void index_gaps(const data_type &region, bool add) {
+            if (!m_gap_index) {
+                return;
             }
-        };
 
-        using adapted_type = set<data_type, data_type_cmp>;
-        adapted_type m_cus;
+            auto y = upper_bound(data_type(region.min(), region.min()));
+            if (y != end() && y == begin()) {
+                ++y;
+            }
+
+            for (; y != end(); ++y) {
+                auto x = prev(y);
+                if (x->max() > region.max()) {
+                    break;
+                }
+
+                pair gap(y->min() - x->max(), x->max());
+                if (add) {
+                    m_gap_index->insert(gap);
+                } else {
+                    m_gap_index->erase(gap);
+                }
+            }
+        }
+
+        // coarse presence bits, kept only after enable_summary()
+        optional<cunits_detail::presence_summary<T>> m_summary;
+
+        // Refreshes the summary over region once it has become covered or
+        // uncovered; of the blocks region touches, only the two at its ends
+        // can also hold other intervals.
+        void summarize(const data_type &region, bool covered) {
+            if (!m_summary || region.empty()) {
+                return;
+            }
+
+            auto first = m_summary->block(region.min());
+            auto last = m_summary->block(region.max());
+            if (m_summary->block_start(last) == region.max()) {
+                --last;
+            }
+
+            m_summary->assign(first, last, covered);
+            if (!covered) {
+                for (auto b: {first, last}) {
+                    auto from = m_summary->block_start(b);
+                    auto i = lower_bound(data_type(from, from));
+                    m_summary->assign(b, b, i != end() && m_summary->block(i->min()) <= b);
+                }
+            }
+        }
+
+        using const_iterator = typename adapted_type::const_iterator;
+
+        // Navigation answers for x, given i, the first interval ending
+        // after x.
+
+        optional<value_type> next_covered_from(const_iterator i, const value_type &x) const {
+            if (i == end()) {
+                return nullopt;
+            }
+            return std::max(x, i->min());
+        }
+
+        optional<value_type> prev_covered_from(const_iterator i, const value_type &x) const {
+            if (i != end() && i->min() <= x) {
+                return x;
+            }
+            if (i == begin()) {
+                return nullopt;
+            }
+            return prev(i)->max() - 1;
+        }
+
+        data_type next_gap_from(const_iterator i, const value_type &x) const {
+            auto from = x;
+            if (i != end() && i->min() <= x) {
+                from = (i++)->max();
+            }
+            return data_type(from, i == end() ? numeric_limits<T>::max() : i->min());
+        }
+
+        optional<value_type> run_end_from(const_iterator i, const value_type &x) const {
+            if (i != end() && i->min() <= x) {
+                return i->max();
+            }
+            return nullopt;
+        }
+
+        // Answers the ascending queries xs with one cursor, galloping when
+        // there are far fewer queries than intervals.
+        template<typename R, typename F>
+        void navigate(span<const value_type> xs, span<R> result, F answer) const {
+            assert(xs.size() == result.size());
+            assert(ranges::is_sorted(xs));
+
+            bool gallop = cunits_detail::skewed(xs.size(), size());
+            auto i = begin();
+
+            for (size_t q = 0; q < xs.size(); ++q) {
+                i = cunits_detail::seek_past(*this, i, xs[q], gallop);
+                result[q] = answer(i, xs[q]);
+            }
+        }
+
+        // with enable_finger(), lookups and inserts start from the last
+        // position they touched, which m_cus keeps
+        bool m_finger = false;
+
+        void remember(const_iterator i) const {
+            if (m_finger && i != end()) {
+                m_cus.set_finger(i);
+            }
+        }
+
+        // First interval ending after v, searched from hint.
+        const_iterator lower_bound_from(const_iterator hint, const value_type &v) const {
+            return m_cus.lower_bound(hint, v);
+        }
+
+        // First interval starting at or after v, searched from hint.
+        const_iterator upper_bound_from(const_iterator hint, const value_type &v) const {
+            auto i = lower_bound_from(hint, v);
+            return i != end() && i->min() < v ? ++i : i;
+        }
+
+        // Inserts new_cu given i, the first interval starting at or after
+        // its end.  The run of intervals new_cu overlaps or touches is found
+        // by a search back from i and replaced by their union with one range
+        // erase and one insert, in O(log n + k) for a run of k.
+        const_iterator insert_at(const_iterator i, const data_type &new_cu) {
+            if (new_cu.empty()) {
+                return i;
+            }
+
+            // the run starts at the first interval ending at or after
+            // new_cu and ends with the one starting at its end, if any
+            auto first = lower_bound_from(i, new_cu.min());
+            if (first != begin() && prev(first)->max() == new_cu.min()) {
+                --first;
+            }
+
+            auto last = i;
+            if (last != end() && last->min() == new_cu.max()) {
+                ++last;
+            }
+
+            if (first != last && next(first) == last && first->includes(new_cu)) {
+                remember(first);
+                return first;
+            }
+
+            auto min = first != last ? std::min(first->min(), new_cu.min()) : new_cu.min();
+            auto max = first != last ? std::max(prev(last)->max(), new_cu.max()) : new_cu.max();
+            data_type insert_cu(min, max);
+
+            index_gaps(insert_cu, false);
+            auto pos = m_cus.insert(m_cus.erase(first, last), insert_cu);
+            index_gaps(insert_cu, true);
+            summarize(new_cu, true);
+            remember(pos);
+
+            assert(*pos == insert_cu);
+            assert(verify());
+            return pos;
+        }
+
+        // Inserts a sorted, coalesced batch: appended when it starts past
+        // the last interval, inserted unit by unit when it is far smaller
+        // than the set, merged with the contents in one pass otherwise.
+        void insert_batch(vector<data_type> batch) {
+            if (batch.empty()) {
+                return;
+            }
+
+            if (empty() || prev(end())->max() <= batch.front().min()) {
+                append(batch.begin(), batch.end());
+                return;
+            }
+
+            if (cunits_detail::skewed(batch.size(), size())) {
+                for (const auto &cu: batch) {
+                    insert(cu);
+                }
+                return;
+            }
+
+            set sorted;
+            sorted.append(batch.begin(), batch.end());
+            set merged;
+            cunits_detail::union_into(*this, sorted, merged);
+            adopt(std::move(merged));
+        }
+
+        // Removes cu from the run [first, last) of intervals it overlaps,
+        // keeping the parts of the end intervals that stick out, which
+        // overwrite the end intervals in place.
+        void erase_run(const_iterator first, const_iterator last, const data_type &cu) {
+            if (first == last || cu.empty()) {
+                return;
+            }
+
+            data_type region(first->min(), prev(last)->max());
+            data_type pieces[2];
+            size_t count = 0;
+            if (region.min() < cu.min()) {
+                pieces[count++] = data_type(region.min(), cu.min());
+            }
+            if (cu.max() < region.max()) {
+                pieces[count++] = data_type(cu.max(), region.max());
+            }
+
+            index_gaps(region, false);
+            auto pos = first;
+            if (count == 2 && next(first) == last) {
+                m_cus.replace(first, pieces[0]);
+                m_cus.insert(last, pieces[1]);
+            } else {
+                // the head piece reuses the first interval and the tail
+                // piece the last, so the order holds throughout
+                auto from = first;
+                auto to = last;
+                if (region.min() < cu.min()) {
+                    m_cus.replace(from++, pieces[0]);
+                }
+                if (cu.max() < region.max()) {
+                    m_cus.replace(--to, pieces[count - 1]);
+                }
+                pos = m_cus.erase(from, to);
+                if (region.min() < cu.min()) {
+                    pos = first;
+                }
+            }
+            index_gaps(region, true);
+            summarize(cu, false);
+            remember(pos);
+            assert(verify());
+        }
+
+        // The ascending values as a set of runs.
+        static set runs_of(span<const value_type> values) {
+            assert(ranges::is_sorted(values));
+
+            set runs;
+            for (const auto &value: values) {
+                runs.append(data_type(value, value + 1));
+            }
+            return runs;
+        }
+
+        // Takes over the intervals of other, rebuilding the optional
+        // indexes over them.
+        void adopt(set &&other) {
+            m_cus = std::move(other.m_cus);
+            reindex();
+        }
+
+        // Rebuilds the optional indexes over the current intervals.
+        void reindex() {
+            if (m_gap_index) {
+                m_gap_index->clear();
+                if (!empty()) {
+                    index_gaps(data_type(begin()->min(), prev(end())->max()), true);
+                }
+            }
+
+            if (m_summary) {
+                m_summary->clear();
+                for (const auto &cu: *this) {
+                    summarize(cu, true);
+                }
+            }
+        }
 
         bool verify() {
             if (auto i = begin(); i != end())
@@ -33,20 +882,45 @@ namespace std {
             return true;
         }
 
+        // Takes over the intervals of cus.
+        explicit set(adapted_type &&cus) : m_cus(std::move(cus)) {
+        }
+
+        template<typename U, typename Kernel>
+        friend set<cunits<U>> cunits_detail::partitioned(const set<cunits<U>> &lhs, const set<cunits<U>> &rhs,
+                                                         launch policy, size_t threads, Kernel kernel);
+
     public:
         // ============================= CONSTRUCTORS =============================
 
         set() = default;
 
         set(initializer_list<data_type> initializer_list) {
-            for (const auto &i: initializer_list) {
-                insert(i);
+            insert(initializer_list.begin(), initializer_list.end());
+        }
+
+        // Loads the units [first, last), in any order and possibly
+        // overlapping, with one sort.
+        template<input_iterator It>
+        set(It first, It last) {
+            insert(first, last);
+        }
+
+        // Materializes a set expression in a single sweep.
+        template<typename E> requires cunits_detail::is_expression<E>
+        set(const E &expression) {
+            for (const auto &cu: expression) {
+                append(cu);
             }
         }
 
+        set(const set &) = default;
+        set(set &&) noexcept = default;
+
         // ============================= OPERATORS =============================
 
         set &operator=(const set &) = default;
+        set &operator=(set &&) noexcept = default;
 
         bool operator<(const set<cunits<T>> &rhs) const {
             return static_cast<adapted_type>(*this) < static_cast<adapted_type>(rhs);
@@ -90,107 +964,716 @@ namespace std {
             return m_cus.size();
         }
 
+        // Total number of covered units, kept in the root of the tree.
+        T cardinality() const {
+            return m_cus.measure();
+        }
+
+        // Number of covered units inside range, in O(log n).
+        T count_in_range(const data_type &range) const {
+            return m_cus.measure_below(range.max()) - m_cus.measure_below(range.min());
+        }
+
+        // Writes the covered units of each bucket_width-wide bucket of range
+        // to out, starting at range.min(); the last bucket is cut short at
+        // range.max() and out must hold them all.  One sweep over the
+        // intervals overlapping range, O(log n + k + buckets).
+        void coverage_histogram(const data_type &range, const T &bucket_width, span<T> out) const {
+            assert(bucket_width > 0);
+            assert(static_cast<T>(out.size()) * bucket_width >= range.size());
+
+            cunits_detail::measure_cursor<const_iterator, T> cursor(lower_bound(range), end());
+            auto from = range.min();
+            auto below = cursor(from);
+
+            for (size_t q = 0; q < out.size(); ++q) {
+                auto to = range.max() - from > bucket_width ? from + bucket_width : range.max();
+                auto next = cursor(to);
+                out[q] = next - below;
+                below = next;
+                from = to;
+            }
+        }
+
+        // Writes the covered units of the window [x, x + width) to out[q],
+        // where x = from + q * step, for every q < out.size().  Both window
+        // edges sweep the intervals once, so the cost is
+        // O(log n + k + windows) however much the windows overlap.
+        void sliding_coverage(const value_type &from, const T &width, const T &step, span<T> out) const {
+            assert(width > 0 && step > 0);
+
+            auto first = lower_bound(data_type(from, from));
+            cunits_detail::measure_cursor<const_iterator, T> lo(first, end());
+            cunits_detail::measure_cursor<const_iterator, T> hi(first, end());
+
+            auto x = from;
+            for (size_t q = 0; q < out.size(); ++q, x += step) {
+                out[q] = hi(x + width) - lo(x);
+            }
+        }
+
         bool includes(const data_type &cu) const {
-            auto i = m_cus.upper_bound(cu);
-            return i != begin() && (--i)->includes(cu);
+            auto i = m_cus.floor(cu.min());
+            return i != end() && i->includes(cu);
         }
 
         bool includes(const set<cunits<T>> &cus) const {
-            return ranges::all_of(cus, [this](const auto &cu) {
-                return this->includes(cu);
-            });
+            // walk both sequences once, galloping over this set when the
+            // argument is much smaller
+            bool gallop = cunits_detail::skewed(cus.size(), size());
+            auto i = begin();
+
+            for (const auto &cu: cus) {
+                i = cunits_detail::seek_past(*this, i, cu.min(), gallop);
+                if (i == end() || !i->includes(cu)) {
+                    return false;
+                }
+            }
+
+            return true;
         }
 
         // ============================= MODIFIERS =============================
 
         void clear() {
             m_cus.clear();
+            if (m_gap_index) {
+                m_gap_index->clear();
+            }
+            if (m_summary) {
+                m_summary->clear();
+            }
         }
 
         void insert(const data_type &new_cu) {
-            auto min = new_cu.min();
-            auto max = new_cu.max();
-            auto i = m_cus.upper_bound(new_cu);
-            auto j = i;
+            insert_at(m_finger ? upper_bound_from(m_cus.finger(), new_cu.max()) : upper_bound(new_cu), new_cu);
+        }
+
+        // Inserts new_cu with the search starting from hint; returns the
+        // interval that now holds it.  The search costs O(log d) for a
+        // position d intervals from hint, but the update stays O(log n),
+        // since the subtree totals are refreshed up to the root.
+        auto insert(const_iterator hint, const data_type &new_cu) {
+            return insert_at(upper_bound_from(hint, new_cu.max()), new_cu);
+        }
+
+        // Inserts the units [first, last), in any order and possibly
+        // overlapping.  The batch is sorted and coalesced on its own, then
+        // merged with the contents in one pass: O(n + m log m) for n
+        // intervals and m units, against a search and a shift per unit.
+        template<input_iterator It>
+        void insert(It first, It last) {
+            insert_range(ranges::subrange(first, last));
+        }
+
+        template<ranges::input_range R>
+        void insert_range(R &&units) {
+            vector<data_type> batch;
+            ranges::copy(units, back_inserter(batch));
+            cunits_detail::coalesce(batch);
+            insert_batch(std::move(batch));
+        }
+
+        // Appends a unit that starts no earlier than the last interval,
+        // merging with it when they overlap or touch.  Amortized O(1).
+        void append(const data_type &cu) {
+            if (cu.empty()) {
+                return;
+            }
+
+            assert(empty() || prev(end())->min() <= cu.min());
+            index_gaps(cu, false);
+
+            if (!empty() && cu.min() <= prev(end())->max()) {
+                auto last = prev(end());
+                m_cus.replace(last, data_type(last->min(), std::max(last->max(), cu.max())));
+            } else {
+                m_cus.insert(m_cus.end(), cu);
+            }
+
+            index_gaps(cu, true);
+            summarize(cu, true);
+        }
 
-            if (min == max) {
+        // Appends the sorted, disjoint units [first, last) in bulk.
+        template<typename It>
+        void append(It first, It last) {
+            if (first == last) {
                 return;
             }
 
-            if (m_cus.contains(new_cu)) {
+            auto from = first->min();
+            append(*first);
+            m_cus.insert(++first, last);
+            index_gaps(data_type(from, prev(end())->max()), true);
+            for (; first != last; ++first) {
+                summarize(*first, true);
+            }
+        }
+
+        // Removes cu, which may span any number of intervals and gaps,
+        // trimming the intervals at its ends, in O(log n + k).
+        void erase(const data_type &cu) {
+            if (cu.empty()) {
                 return;
             }
 
-            if (auto i2 = i; i2 != begin() && (--i2)->max() >= new_cu.min()) {
-                --i;
-                min = i->min();
+            auto first = m_finger ? lower_bound_from(m_cus.finger(), cu.min()) : lower_bound(cu);
+            erase_run(first, upper_bound_from(first, cu.max()), cu);
+        }
+
+        // Removes a single value with one lookup.
+        void erase(const value_type &value) {
+            if (auto i = find(value); i != end()) {
+                erase_run(i, next(i), data_type(value, value + 1));
             }
+        }
+
+        void erase(const typename adapted_type::iterator &it) {
+            // copy first: the unit is overwritten as it is erased
+            erase_run(it, next(it), data_type(*it));
+        }
 
-            if (j != end() && new_cu.max() >= j->min()) {
-                max = j->max();
-                ++j;
+        // Removes the ascending values.  They are coalesced into runs first
+        // and the runs removed in one merge pass, or one by one when
+        // there are far fewer runs than intervals: O(n + m) where
+        // erasing the values one at a time splits an interval per value.
+        void erase_values(span<const value_type> values) {
+            auto runs = runs_of(values);
+            if (empty() || runs.empty()) {
+                return;
             }
 
-            j = m_cus.erase(i, j);
-            data_type insert_cu(min, max);
-            auto pos = m_cus.insert(j, insert_cu);
+            if (cunits_detail::skewed(runs.size(), size())) {
+                for (const auto &cu: runs) {
+                    erase(cu);
+                }
+                return;
+            }
 
-            assert(*pos == insert_cu);
-            assert(verify());
+            adopt(difference(*this, runs));
         }
 
-        void erase(const data_type &new_cu) {
-            auto i = m_cus.lower_bound(new_cu);
+        // Parallel version for huge batches: the runs are removed by key
+        // partitions, as in the parallel difference().
+        void erase_values(span<const value_type> values, launch policy,
+                          size_t threads = thread::hardware_concurrency()) {
+            auto runs = runs_of(values);
+            if (empty() || runs.empty()) {
+                return;
+            }
+
+            adopt(difference(*this, runs, policy, threads));
+        }
 
-            assert(i != end());
+        // Removes the intervals satisfying pred in one pass and returns how
+        // many there were.
+        template<typename P>
+        size_t erase_if(P pred) {
+            vector<data_type> kept;
+            for (const auto &cu: *this) {
+                if (!pred(cu)) {
+                    kept.push_back(cu);
+                }
+            }
 
-            const auto erase_cu = *i;
-            assert(erase_cu.includes(new_cu));
+            auto count = size() - kept.size();
+            m_cus.clear();
+            m_cus.insert(kept.begin(), kept.end());
+            reindex();
+            return count;
+        }
 
-            i = m_cus.erase(i);
+        // ============================= LOOKUP =============================
 
-            if (new_cu.max() < erase_cu.max()) {
-                data_type insert_cu(new_cu.max(), erase_cu.max());
-                i = m_cus.insert(i, insert_cu);
+        auto find(const data_type &new_cu) const {
+            if (m_summary && !new_cu.empty() && !m_summary->test(new_cu.min())) {
+                return end();
             }
+            auto i = m_cus.floor(new_cu.min());
+            return i != end() && i->includes(new_cu) ? i : end();
+        }
 
-            if (erase_cu.min() < new_cu.min()) {
-                data_type insert_cu(erase_cu.min(), new_cu.min());
-                m_cus.insert(i, insert_cu);
+        auto find(const value_type &value) const {
+            if (m_summary && !m_summary->test(value)) {
+                return end();
             }
+            return m_finger ? find(m_cus.finger(), value) : find(data_type(value, value + 1));
+        }
 
-            assert(verify());
+        // Looks up value with the search starting from hint, in expected
+        // O(log d) for a result d intervals away.
+        auto find(const_iterator hint, const value_type &value) const {
+            auto i = lower_bound_from(hint, value);
+            remember(i);
+            return i != end() && i->min() <= value ? i : end();
         }
 
-        void erase(const typename adapted_type::iterator &it) {
-            m_cus.erase(*it);
+        // Makes find(value), insert and erase start from the position the
+        // previous call touched, which pays off when consecutive calls land
+        // close together.  The const find(value) moves that position too,
+        // through a relaxed atomic, so const lookups from several threads
+        // stay safe; they only make each other's starting points worse.
+        void enable_finger() {
+            m_finger = true;
+        }
+
+        void disable_finger() {
+            m_finger = false;
+        }
+
+        // Keeps one bit per block of 2^shift values telling whether any of
+        // them is covered, so that find and contains answer most misses with
+        // a single bit test.  Costs a bit per block between the lowest and
+        // the highest covered value, and a few word writes per modification.
+        void enable_summary(unsigned shift) {
+            m_summary.emplace(shift);
+            for (const auto &cu: *this) {
+                summarize(cu, true);
+            }
+        }
+
+        void disable_summary() {
+            m_summary.reset();
+        }
+
+        bool contains(const data_type &cu) {
+            return find(cu) != end();
+        }
+
+        bool contains(const value_type &value) {
+            return find(value) != end();
+        }
+
+        // Looks up the ascending values with one merge walk over the
+        // intervals, galloping when there are far fewer values than
+        // intervals; result[q] is find(values[q]).
+        void find_batch(span<const value_type> values, span<const_iterator> result) const {
+            navigate(values, result, [this](auto i, const value_type &x) {
+                return i != end() && i->min() <= x ? i : end();
+            });
+        }
+
+        // As above, but sets bit q % 64 of found[q / 64] when values[q] is
+        // covered and clears it otherwise.
+        void find_batch(span<const value_type> values, span<uint64_t> found) const {
+            assert(found.size() * 64 >= values.size());
+            assert(ranges::is_sorted(values));
+
+            ranges::fill(found, 0);
+            bool gallop = cunits_detail::skewed(values.size(), size());
+            auto i = begin();
+
+            for (size_t q = 0; q < values.size(); ++q) {
+                i = cunits_detail::seek_past(*this, i, values[q], gallop);
+                if (i != end() && i->min() <= values[q]) {
+                    found[q / 64] |= uint64_t{1} << (q % 64);
+                }
+            }
+        }
+
+        // Looks up values in any order, interleaving the descents of
+        // lookup_lanes values at a time; result[q] is find(values[q]).
+        void find_many(span<const value_type> values, span<const_iterator> result) const {
+            assert(values.size() == result.size());
+
+            m_cus.template floor_many<cunits_detail::lookup_lanes>(values, result);
+            for (size_t q = 0; q < values.size(); ++q) {
+                if (result[q] != end() && !result[q]->contains(values[q])) {
+                    result[q] = end();
+                }
+            }
+        }
+
+        // Sets bit q % 64 of found[q / 64] when values[q] is covered and
+        // clears it otherwise.  Ascending values take the merge walk of
+        // find_batch, others the interleaved descents of find_many.
+        void contains_many(span<const value_type> values, span<uint64_t> found) const {
+            if (ranges::is_sorted(values)) {
+                find_batch(values, found);
+                return;
+            }
+
+            assert(found.size() * 64 >= values.size());
+            ranges::fill(found, 0);
+
+            constexpr size_t lanes = cunits_detail::lookup_lanes;
+            static_assert(64 % lanes == 0);
+            const_iterator floors[lanes];
+
+            for (size_t q0 = 0; q0 < values.size(); q0 += lanes) {
+                auto x = values.subspan(q0, std::min(lanes, values.size() - q0));
+                m_cus.template floor_many<lanes>(x, span(floors, x.size()));
+
+                uint64_t bits = 0;
+                for (size_t g = 0; g < x.size(); ++g) {
+                    bits |= uint64_t{floors[g] != end() && floors[g]->contains(x[g])} << g;
+                }
+                found[q0 / 64] |= bits << q0 % 64;
+            }
+        }
+
+        auto lower_bound(const data_type &new_cu) const {
+            return m_cus.lower_bound(new_cu);
+        }
+
+        auto upper_bound(const data_type &new_cu) const {
+            return m_cus.upper_bound(new_cu);
+        }
+
+        // The intervals sharing at least one unit with cu, in O(log n).
+        auto overlapping(const data_type &cu) const {
+            auto last = upper_bound(cu);
+            return ranges::subrange(cu.empty() ? last : lower_bound(cu), last);
+        }
+
+        // The overlapping intervals trimmed to cu, as a view over the set.
+        auto clipped(const data_type &cu) const {
+            return overlapping(cu) | views::transform([cu](const data_type &x) {
+                return data_type(std::max(x.min(), cu.min()), std::min(x.max(), cu.max()));
+            });
+        }
+
+        // Number of covered values below value, in O(log n).
+        T rank(const value_type &value) const {
+            return m_cus.measure_below(value);
+        }
+
+        // The k-th covered value, counting from 0, in O(log n); k must be
+        // below cardinality().
+        value_type select(const T &k) const {
+            return m_cus.value_at(k);
+        }
+
+        // Ranks the ascending values into result with one merge walk,
+        // or one search per value when there are far fewer values than
+        // intervals.
+        void rank(span<const value_type> values, span<T> result) const {
+            assert(values.size() == result.size());
+            assert(ranges::is_sorted(values));
+
+            if (cunits_detail::skewed(values.size(), size())) {
+                ranges::transform(values, result.begin(), [this](const value_type &v) { return rank(v); });
+                return;
+            }
+
+            auto i = begin();
+            T below{};
+
+            for (size_t q = 0; q < values.size(); ++q) {
+                const auto &v = values[q];
+                for (; i != end() && i->max() <= v; ++i) {
+                    below += i->size();
+                }
+                result[q] = i != end() && i->min() < v ? below + (v - i->min()) : below;
+            }
+        }
+
+        // Selects the ascending ranks ks into result, walking or searching
+        // like the batched rank().
+        void select(span<const T> ks, span<value_type> result) const {
+            assert(ks.size() == result.size());
+            assert(ranges::is_sorted(ks));
+
+            if (cunits_detail::skewed(ks.size(), size())) {
+                ranges::transform(ks, result.begin(), [this](const T &k) { return select(k); });
+                return;
+            }
+
+            auto i = begin();
+            T before{};
+
+            for (size_t q = 0; q < ks.size(); ++q) {
+                assert(ks[q] < cardinality());
+                for (; before + i->size() <= ks[q]; ++i) {
+                    before += i->size();
+                }
+                result[q] = i->min() + (ks[q] - before);
+            }
+        }
+
+        // ============================= NAVIGATION =============================
+
+        // Smallest covered value at or after x.
+        optional<value_type> next_covered(const value_type &x) const {
+            return next_covered_from(lower_bound(data_type(x, x)), x);
+        }
+
+        // Largest covered value at or before x.
+        optional<value_type> prev_covered(const value_type &x) const {
+            return prev_covered_from(lower_bound(data_type(x, x)), x);
+        }
+
+        // The free run at or after x, clipped to start no earlier than x;
+        // past the last interval it extends to numeric_limits<T>::max().
+        data_type next_gap(const value_type &x) const {
+            return next_gap_from(lower_bound(data_type(x, x)), x);
+        }
+
+        // End of the interval covering x, if any.
+        optional<value_type> run_end(const value_type &x) const {
+            return run_end_from(lower_bound(data_type(x, x)), x);
+        }
+
+        // Batched forms of the above for ascending queries.
+
+        void next_covered(span<const value_type> xs, span<optional<value_type>> result) const {
+            navigate(xs, result, [this](auto i, const value_type &x) { return next_covered_from(i, x); });
+        }
+
+        void prev_covered(span<const value_type> xs, span<optional<value_type>> result) const {
+            navigate(xs, result, [this](auto i, const value_type &x) { return prev_covered_from(i, x); });
+        }
+
+        void next_gap(span<const value_type> xs, span<data_type> result) const {
+            navigate(xs, result, [this](auto i, const value_type &x) { return next_gap_from(i, x); });
+        }
+
+        void run_end(span<const value_type> xs, span<optional<value_type>> result) const {
+            navigate(xs, result, [this](auto i, const value_type &x) { return run_end_from(i, x); });
+        }
+
+        // ============================= GAPS =============================
+
+        // Lowest k contiguous free units inside universe (first fit).
+        optional<data_type> find_first_gap(const T &k, const data_type &universe) const {
+            assert(k > 0);
+
+            auto from = universe.min();
+            auto a = lower_bound(data_type(from, from));
+
+            if (a == end() || from < a->min()) {
+                auto to = a == end() ? universe.max() : std::min(a->min(), universe.max());
+                if (to - from >= k) {
+                    return data_type(from, from + k);
+                }
+                if (a == end()) {
+                    return nullopt;
+                }
+            }
+
+            // gaps only start later from here on, so the first wide enough
+            // one decides
+            auto x = gap_after(a, k);
+            auto start = x == end() ? prev(end())->max() : x->max();
+            if (start + k <= universe.max()) {
+                return data_type(start, start + k);
+            }
+
+            return nullopt;
+        }
+
+        // First fit among the free units of universe at or after from.
+        optional<data_type> find_first_gap(const T &k, const data_type &universe, const value_type &from) const {
+            auto start = std::clamp(from, universe.min(), universe.max());
+            return find_first_gap(k, data_type(start, universe.max()));
+        }
+
+        // Highest k contiguous free units inside universe (last fit).
+        optional<data_type> find_last_gap(const T &k, const data_type &universe) const {
+            assert(k > 0);
+
+            auto to = universe.max();
+            auto b = upper_bound(data_type(to, to));
+
+            if (b == begin() || prev(b)->max() < to) {
+                auto from = b == begin() ? universe.min() : std::max(prev(b)->max(), universe.min());
+                if (to - from >= k) {
+                    return data_type(to - k, to);
+                }
+                if (b == begin()) {
+                    return nullopt;
+                }
+            }
+
+            auto y = gap_before(prev(b), k);
+            auto stop = y == end() ? begin()->min() : y->min();
+            if (universe.min() + k <= stop) {
+                return data_type(stop - k, stop);
+            }
+
+            return nullopt;
+        }
+
+        // Indexes the gaps between intervals by size, making the best- and
+        // worst-fit queries O(log n) at the cost of O(log n) per touched
+        // gap in every modifier.
+        void enable_gap_index() {
+            m_gap_index.emplace();
+            if (!empty()) {
+                index_gaps(data_type(begin()->min(), prev(end())->max()), true);
+            }
+        }
+
+        void disable_gap_index() {
+            m_gap_index.reset();
+        }
+
+        // Smallest gap between two intervals with room for k units; the
+        // lowest one wins a tie.
+        optional<data_type> find_best_fit(const T &k) const {
+            assert(k > 0);
+
+            if (m_gap_index) {
+                auto g = m_gap_index->lower_bound({k, numeric_limits<T>::lowest()});
+                if (g == m_gap_index->end()) {
+                    return nullopt;
+                }
+                return data_type(g->second, g->second + g->first);
+            }
+
+            optional<data_type> best;
+            for (auto x = begin(), y = x; y != end() && ++y != end(); x = y) {
+                if (y->min() - x->max() >= k && (!best || y->min() - x->max() < best->size())) {
+                    best = data_type(x->max(), y->min());
+                }
+            }
+            return best;
+        }
+
+        // Largest gap between two intervals; the lowest one wins a tie.
+        optional<data_type> find_worst_fit() const {
+            if (m_gap_index) {
+                if (m_gap_index->empty()) {
+                    return nullopt;
+                }
+                auto g = m_gap_index->lower_bound({prev(m_gap_index->end())->first, numeric_limits<T>::lowest()});
+                return data_type(g->second, g->second + g->first);
+            }
+
+            optional<data_type> worst;
+            for (auto x = begin(), y = x; y != end() && ++y != end(); x = y) {
+                if (!worst || y->min() - x->max() > worst->size()) {
+                    worst = data_type(x->max(), y->min());
+                }
+            }
+            return worst;
+        }
+
+        // The k largest intervals, largest first and the lowest first among
+        // equals, in one pass that keeps the best k in a heap: O(n log k),
+        // without copying or sorting the set.
+        vector<data_type> largest_intervals(size_t k) const {
+            cunits_detail::top_k<T> best(k);
+            for (const auto &cu: *this) {
+                best.offer(cu);
+            }
+            return std::move(best).take();
+        }
+
+        // The k largest uncovered runs within universe, ordered like
+        // largest_intervals().  With the gap index the gaps are visited from
+        // the largest down until no smaller one can qualify; otherwise the
+        // intervals overlapping universe are walked once.
+        vector<data_type> largest_gaps(size_t k, const data_type &universe) const {
+            cunits_detail::top_k<T> best(k);
+
+            if (!k || universe.empty()) {
+                return {};
+            }
+
+            if (!m_gap_index) {
+                auto from = universe.min();
+                for (const auto &cu: overlapping(universe)) {
+                    if (from < cu.min()) {
+                        best.offer(data_type(from, cu.min()));
+                    }
+                    from = cu.max();
+                }
+                if (from < universe.max()) {
+                    best.offer(data_type(from, universe.max()));
+                }
+                return std::move(best).take();
+            }
+
+            // the runs before the first and after the last interval are not
+            // indexed
+            auto first = empty() ? universe.max() : begin()->min();
+            auto last = empty() ? universe.min() : prev(end())->max();
+            if (universe.min() < first) {
+                best.offer(data_type(universe.min(), std::min(first, universe.max())));
+            }
+            if (last < universe.max() && !empty()) {
+                best.offer(data_type(std::max(last, universe.min()), universe.max()));
+            }
+
+            for (auto g = m_gap_index->rbegin(); g != m_gap_index->rend(); ++g) {
+                if (best.full() && g->first < best.worst()) {
+                    break;
+                }
+
+                auto min = std::max(g->second, universe.min());
+                auto max = std::min(g->second + g->first, universe.max());
+                if (min < max) {
+                    best.offer(data_type(min, max));
+                }
+            }
+
+            return std::move(best).take();
         }
 
-        // ============================= LOOKUP =============================
+        // ============================= SAMPLING =============================
 
-        auto find(const data_type &new_cu) const {
-            auto i = m_cus.upper_bound(new_cu);
-            return i != begin() && (--i)->includes(new_cu) ? i : end();
+        // A uniformly random covered value, in O(log n); the set must not be
+        // empty.
+        template<typename R>
+        value_type sample_value(R &rng) const {
+            assert(!empty());
+            return select(cunits_detail::draw(rng, cardinality()));
         }
 
-        auto find(const value_type &value) const {
-            return find(data_type(value, value + 1));
-        }
+        // Fills out with uniformly random covered values, in ascending
+        // order: the ranks are drawn and sorted first, so one walk selects
+        // them all.
+        template<typename R>
+        void sample_values(R &rng, span<value_type> out) const {
+            assert(!empty() || out.empty());
 
-        bool contains(const data_type &cu) {
-            return find(cu) != end();
+            vector<T> ks(out.size());
+            for (auto &k: ks) {
+                k = cunits_detail::draw(rng, cardinality());
+            }
+            ranges::sort(ks);
+            select(ks, out);
         }
 
-        bool contains(const value_type &value) {
-            return find(value) != end();
-        }
+        // A gap between two intervals of at least min_size units, drawn with
+        // probability proportional to its size, or nullopt if there is none.
+        // Each draw picks a uniformly random uncovered unit in O(log n) and
+        // keeps its gap if it is large enough; after sample_attempts misses
+        // the large enough gaps are listed and one is drawn from them.
+        template<typename R>
+        optional<data_type> sample_gap(R &rng, const T &min_size) const {
+            assert(min_size > 0);
+
+            if (empty() || gap_after(begin(), min_size) == end()) {
+                return nullopt;
+            }
 
-        auto lower_bound(const data_type &new_cu) const {
-            return m_cus.lower_bound(new_cu);
-        }
+            auto uncovered = prev(end())->max() - begin()->min() - cardinality();
+            for (int attempt = 0; attempt < cunits_detail::sample_attempts; ++attempt) {
+                auto y = m_cus.gap_select(cunits_detail::draw(rng, uncovered));
+                data_type gap(prev(y)->max(), y->min());
+                if (gap.size() >= min_size) {
+                    return gap;
+                }
+            }
 
-        auto upper_bound(const data_type &new_cu) const {
-            return m_cus.upper_bound(new_cu);
+            vector<data_type> candidates;
+            T total{};
+            for (auto x = gap_after(begin(), min_size); x != end(); x = gap_after(next(x), min_size)) {
+                candidates.emplace_back(x->max(), next(x)->min());
+                total += candidates.back().size();
+            }
+
+            auto k = cunits_detail::draw(rng, total);
+            for (const auto &gap: candidates) {
+                if (k < gap.size()) {
+                    return gap;
+                }
+                k -= gap.size();
+            }
+            return candidates.back();
         }
 
         // ============================= CONVERSIONS =============================
@@ -236,6 +1719,12 @@ namespace std {
 
     // ============================= NON-MEMBER FUNCTIONS =============================
 
+    // Removes the intervals satisfying pred, like erase_if on other sets.
+    template<typename T, typename P>
+    size_t erase_if(set<cunits<T>> &cus, P pred) {
+        return cus.erase_if(pred);
+    }
+
     template<typename T>
     bool operator==(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs) {
         return ranges::equal(lhs, rhs);
@@ -277,38 +1766,417 @@ namespace std {
         return is;
     }
 
-    template<typename T>
-    set<cunits<T>> intersection(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs) {
-        set<cunits<T>> ret;
+    namespace cunits_detail {
+        // The set algebra kernels read two sorted ranges of disjoint units
+        // (sets, or key_ranges of them) and append the result to out.
 
-        auto i = lhs.begin();
-        auto j = rhs.begin();
+        template<typename L, typename R, typename Out>
+        void intersect_into(const L &lhs, const R &rhs, Out &out) {
+            // gallop through the larger range when the sizes are skewed
+            if (skewed(rhs.size(), lhs.size())) {
+                intersect_into(rhs, lhs, out);
+                return;
+            }
+
+            if (skewed(lhs.size(), rhs.size())) {
+                auto j = rhs.begin();
+
+                for (const auto &cu: lhs) {
+                    j = seek_past(rhs, j, cu.min(), true);
+                    for (auto k = j; k != rhs.end() && k->min() < cu.max(); ++k) {
+                        out.append({std::max(cu.min(), k->min()), std::min(cu.max(), k->max())});
+                    }
+                }
+
+                return;
+            }
+
+            auto i = lhs.begin();
+            auto j = rhs.begin();
+
+            while (i != lhs.end() && j != rhs.end()) {
+                if (i->max() <= j->min()) {
+                    ++i;
+                    continue;
+                }
+
+                if (j->max() <= i->min()) {
+                    ++j;
+                    continue;
+                }
+
+                auto min = std::max(i->min(), j->min());
+                auto max = std::min(i->max(), j->max());
+                out.append({min, max});
 
-        while (i != lhs.end() && j != rhs.end()) {
-            if (i->max() <= j->min()) {
-                ++i;
-                continue;
+                if (i->max() < j->max()) {
+                    ++i;
+                } else {
+                    ++j;
+                }
             }
+        }
 
-            if (j->max() <= i->min()) {
-                ++j;
-                continue;
+        template<typename L, typename R, typename Out>
+        void union_into(const L &lhs, const R &rhs, Out &out) {
+            if (lhs.size() > rhs.size()) {
+                union_into(rhs, lhs, out);
+                return;
             }
 
-            auto min = std::max(i->min(), j->min());
-            auto max = std::min(i->max(), j->max());
-            ret.insert({min, max});
+            // copy the runs of the larger range that fall between the units
+            // of the smaller one in bulk
+            if (skewed(lhs.size(), rhs.size())) {
+                auto j = rhs.begin();
+
+                for (const auto &cu: lhs) {
+                    auto k = seek_past(rhs, j, cu.min(), true);
+                    out.append(j, k);
+                    j = k;
+
+                    while (j != rhs.end() && j->min() <= cu.min()) {
+                        out.append(*j++);
+                    }
+                    out.append(cu);
+                    while (j != rhs.end() && j->min() <= cu.max()) {
+                        out.append(*j++);
+                    }
+                }
 
-            if (i->max() < j->max()) {
-                ++i;
-            } else {
-                ++j;
+                out.append(j, rhs.end());
+                return;
+            }
+
+            if (rhs.size() == 0) {
+                return;
+            }
+
+            auto i = lhs.begin();
+            auto j = rhs.begin();
+
+            auto next = [&] {
+                return j == rhs.end() || (i != lhs.end() && i->min() < j->min()) ? *i++ : *j++;
+            };
+
+            // coalesce locally and append only finished units
+            auto cur = next();
+
+            while (i != lhs.end() || j != rhs.end()) {
+                auto cu = next();
+                if (cur.max() < cu.min()) {
+                    out.append(cur);
+                    cur = cu;
+                } else if (cur.max() < cu.max()) {
+                    cur = {cur.min(), cu.max()};
+                }
+            }
+
+            out.append(cur);
+        }
+
+        template<typename L, typename R, typename Out>
+        void difference_into(const L &lhs, const R &rhs, Out &out) {
+            // a small subtrahend: gallop through lhs, copying the untouched
+            // runs between the removed units in bulk
+            if (skewed(rhs.size(), lhs.size())) {
+                auto i = lhs.begin();
+                bool cut = false;
+                remove_cvref_t<decltype(i->min())> lo{};
+
+                for (const auto &cu: rhs) {
+                    if (i == lhs.end()) {
+                        break;
+                    }
+
+                    auto k = seek_past(lhs, i, cu.min(), true);
+                    if (k != i) {
+                        if (cut) {
+                            out.append({lo, i->max()});
+                            ++i;
+                            cut = false;
+                        }
+                        out.append(i, k);
+                        i = k;
+                    }
+
+                    while (i != lhs.end() && i->min() < cu.max()) {
+                        auto min = cut ? lo : i->min();
+                        if (min < cu.min()) {
+                            out.append({min, cu.min()});
+                        }
+
+                        if (cu.max() < i->max()) {
+                            cut = true;
+                            lo = cu.max();
+                            break;
+                        }
+
+                        ++i;
+                        cut = false;
+                    }
+                }
+
+                if (i != lhs.end() && cut) {
+                    out.append({lo, i->max()});
+                    ++i;
+                }
+                out.append(i, lhs.end());
+                return;
+            }
+
+            // otherwise walk lhs, galloping through rhs when it is the larger
+            bool gallop = skewed(lhs.size(), rhs.size());
+            auto j = rhs.begin();
+
+            for (const auto &cu: lhs) {
+                j = seek_past(rhs, j, cu.min(), gallop);
+
+                auto min = cu.min();
+                for (auto k = j; k != rhs.end() && k->min() < cu.max(); ++k) {
+                    if (min < k->min()) {
+                        out.append({min, k->min()});
+                    }
+                    min = k->max();
+                }
+
+                if (min < cu.max()) {
+                    out.append({min, cu.max()});
+                }
+            }
+        }
+
+        // The units of a tree overlapping the keys [lo, hi), unclipped,
+        // counted from the subtree totals in O(log n).
+        template<typename T>
+        class key_range {
+            using data_type = cunits<T>;
+            using iterator = typename cunits_tree<T>::iterator;
+
+            const cunits_tree<T> *m_tree;
+            T m_hi;
+            iterator m_first;
+            iterator m_last;
+            size_t m_size;
+
+        public:
+            key_range(const cunits_tree<T> &tree, const T &lo, const T &hi)
+                    : m_tree(&tree), m_hi(hi),
+                      m_first(tree.lower_bound({lo, lo})),
+                      m_last(tree.upper_bound({hi, hi})),
+                      m_size(tree.position(m_last) - tree.position(m_first)) {
+            }
+
+            iterator begin() const {
+                return m_first;
+            }
+
+            iterator end() const {
+                return m_last;
+            }
+
+            size_t size() const {
+                return m_size;
+            }
+
+            iterator lower_bound(const data_type &cu) const {
+                auto i = m_tree->lower_bound(cu);
+                return i == m_tree->end() || m_hi <= i->min() ? m_last : i;
+            }
+        };
+
+        // Appends to out only the parts of units within the keys [lo, hi).
+        template<typename Out, typename V>
+        class clip_appender {
+            Out &m_out;
+            V m_lo;
+            V m_hi;
+
+        public:
+            clip_appender(Out &out, const V &lo, const V &hi) : m_out(out), m_lo(lo), m_hi(hi) {
+            }
+
+            void append(const cunits<V> &cu) {
+                auto min = std::max(cu.min(), m_lo);
+                auto max = std::min(cu.max(), m_hi);
+                if (min < max) {
+                    m_out.append({min, max});
+                }
+            }
+
+            template<typename It>
+            void append(It first, It last) {
+                for (; first != last; ++first) {
+                    append(*first);
+                }
+            }
+        };
+
+        // Partitions whose larger input holds fewer units than this are not
+        // worth a thread of their own.
+        inline constexpr size_t parallel_grain = 1 << 14;
+
+        // The output of one partition: units appended in order, merged with
+        // the previous one when they overlap or touch.  skip is 1 once the
+        // first unit has been merged into an earlier partition.
+        template<typename T>
+        struct partition_piece {
+            vector<cunits<T>> units;
+            size_t skip = 0;
+
+            void append(const cunits<T> &cu) {
+                if (cu.empty()) {
+                    return;
+                }
+
+                if (!units.empty() && cu.min() <= units.back().max()) {
+                    auto &last = units.back();
+                    last = cunits<T>(last.min(), std::max(last.max(), cu.max()));
+                } else {
+                    units.push_back(cu);
+                }
+            }
+
+            template<typename It>
+            void append(It first, It last) {
+                for (; first != last; ++first) {
+                    append(*first);
+                }
+            }
+        };
+
+        // Runs task(p) for every partition p with the given launch policy
+        // and waits for all of them.
+        template<typename Task>
+        void for_each_partition(launch policy, size_t parts, Task task) {
+            vector<future<void>> done;
+            for (size_t p = 0; p < parts; ++p) {
+                done.push_back(async(policy, task, p));
+            }
+            for (auto &d: done) {
+                d.get();
+            }
+        }
+
+        // Merges the units that touch across the seams between consecutive
+        // pieces into the earlier piece, in O(parts).
+        template<typename T>
+        void stitch(vector<partition_piece<T>> &pieces) {
+            cunits<T> *tail = nullptr;
+
+            for (auto &piece: pieces) {
+                if (piece.units.empty()) {
+                    continue;
+                }
+
+                const auto &head = piece.units.front();
+                if (tail && head.min() <= tail->max()) {
+                    *tail = cunits<T>(tail->min(), std::max(tail->max(), head.max()));
+                    piece.skip = 1;
+                    if (piece.units.size() == 1) {
+                        continue;
+                    }
+                }
+                tail = &piece.units.back();
+            }
+        }
+
+        // Splits the keys covered by lhs and rhs at boundaries sampled by
+        // position from the larger set into up to threads partitions and
+        // runs kernel on each with the given launch policy.  Once the pieces
+        // are stitched at the seams, every partition builds a tree of its
+        // own in O(k), and the trees are joined in O(log n) each.
+        template<typename T, typename Kernel>
+        set<cunits<T>> partitioned(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs, launch policy,
+                                   size_t threads, Kernel kernel) {
+            const auto &large = lhs.size() < rhs.size() ? rhs : lhs;
+            size_t parts = std::min(threads, large.size() / parallel_grain);
+
+            if (parts < 2 || lhs.empty() || rhs.empty()) {
+                set<cunits<T>> ret;
+                kernel(lhs, rhs, ret);
+                return ret;
+            }
+
+            auto bounds = sample_bounds(large.m_cus, parts);
+            bounds.front() = std::min(lhs.begin()->min(), rhs.begin()->min());
+            bounds.back() = std::max(prev(lhs.end())->max(), prev(rhs.end())->max());
+
+            vector<partition_piece<T>> pieces(parts);
+            for_each_partition(policy, parts, [&](size_t p) {
+                key_range l(lhs.m_cus, bounds[p], bounds[p + 1]);
+                key_range r(rhs.m_cus, bounds[p], bounds[p + 1]);
+                pieces[p].units.reserve(l.size() + r.size());
+                clip_appender out(pieces[p], bounds[p], bounds[p + 1]);
+                kernel(l, r, out);
+            });
+
+            stitch(pieces);
+
+            vector<cunits_tree<T>> trees;
+            for (size_t p = 0; p < parts; ++p) {
+                trees.emplace_back(static_cast<uint32_t>(p + 1) * 2654435761u);
+            }
+            for_each_partition(policy, parts, [&](size_t p) {
+                const auto &piece = pieces[p].units;
+                trees[p].insert(piece.begin() + pieces[p].skip, piece.end());
+            });
+
+            for (size_t p = 1; p < parts; ++p) {
+                trees.front().join(std::move(trees[p]));
             }
+            return set<cunits<T>>(std::move(trees.front()));
         }
+    }
+
+    template<typename T>
+    set<cunits<T>> intersection(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs) {
+        set<cunits<T>> ret;
+        cunits_detail::intersect_into(lhs, rhs, ret);
+        return ret;
+    }
+
+    template<typename T>
+    set<cunits<T>> union_of(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs) {
+        set<cunits<T>> ret;
+        cunits_detail::union_into(lhs, rhs, ret);
+        return ret;
+    }
 
+    template<typename T>
+    set<cunits<T>> difference(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs) {
+        set<cunits<T>> ret;
+        cunits_detail::difference_into(lhs, rhs, ret);
         return ret;
     }
 
+    // Parallel versions for huge inputs: the key space is split into one
+    // partition per thread and the partitions are processed with the given
+    // launch policy.
+
+    template<typename T>
+    set<cunits<T>> intersection(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs, launch policy,
+                           size_t threads = thread::hardware_concurrency()) {
+        return cunits_detail::partitioned(lhs, rhs, policy, threads, [](const auto &l, const auto &r, auto &out) {
+            cunits_detail::intersect_into(l, r, out);
+        });
+    }
+
+    template<typename T>
+    set<cunits<T>> union_of(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs, launch policy,
+                           size_t threads = thread::hardware_concurrency()) {
+        return cunits_detail::partitioned(lhs, rhs, policy, threads, [](const auto &l, const auto &r, auto &out) {
+            cunits_detail::union_into(l, r, out);
+        });
+    }
+
+    template<typename T>
+    set<cunits<T>> difference(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs, launch policy,
+                           size_t threads = thread::hardware_concurrency()) {
+        return cunits_detail::partitioned(lhs, rhs, policy, threads, [](const auto &l, const auto &r, auto &out) {
+            cunits_detail::difference_into(l, r, out);
+        });
+    }
+
     template<typename T>
     set<cunits<T>> intersection(const set<cunits<T>> &lhs, const cunits<T> &rhs) {
         return intersection(lhs, set<cunits<T>>{rhs});
@@ -324,4 +2192,267 @@ namespace std {
         return intersection(set<cunits<T>>{lhs}, set<cunits<T>>{rhs});
     }
 
-}
\ No newline at end of file
+    // ============================= MEASURES =============================
+
+    // The measure of a set is the number of units it covers.  None of the
+    // functions below allocate; each walks the sets once, galloping
+    // through the larger one when their sizes are skewed.
+
+    template<typename T>
+    bool overlaps(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs) {
+        if (lhs.size() > rhs.size()) {
+            return overlaps(rhs, lhs);
+        }
+
+        bool gallop = cunits_detail::skewed(lhs.size(), rhs.size());
+        auto j = rhs.begin();
+
+        for (const auto &cu: lhs) {
+            j = cunits_detail::seek_past(rhs, j, cu.min(), gallop);
+            if (j == rhs.end()) {
+                return false;
+            }
+            if (j->min() < cu.max()) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    template<typename T>
+    T intersection_measure(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs) {
+        if (lhs.size() > rhs.size()) {
+            return intersection_measure(rhs, lhs);
+        }
+
+        bool gallop = cunits_detail::skewed(lhs.size(), rhs.size());
+        auto j = rhs.begin();
+        T result{};
+
+        for (const auto &cu: lhs) {
+            j = cunits_detail::seek_past(rhs, j, cu.min(), gallop);
+            for (auto k = j; k != rhs.end() && k->min() < cu.max(); ++k) {
+                result += std::min(cu.max(), k->max()) - std::max(cu.min(), k->min());
+            }
+        }
+
+        return result;
+    }
+
+    template<typename T>
+    T union_measure(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs) {
+        return lhs.cardinality() + rhs.cardinality() - intersection_measure(lhs, rhs);
+    }
+
+    // |lhs & rhs| / |lhs | rhs|; two empty sets are identical, so 1.
+    template<typename T>
+    double jaccard(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs) {
+        auto common = intersection_measure(lhs, rhs);
+        auto united = lhs.cardinality() + rhs.cardinality() - common;
+        return united ? static_cast<double>(common) / static_cast<double>(united) : 1.0;
+    }
+
+    // ============================= K-WAY OPERATIONS =============================
+
+    // Intersects all sets in a single sweep: the cursors leapfrog each
+    // other to the largest lower endpoint, galloping through inputs much
+    // larger than the smallest one.  Stops as soon as any input runs out.
+    template<typename T>
+    set<cunits<T>> intersect_all(span<const set<cunits<T>> *const> sets) {
+        set<cunits<T>> ret;
+
+        if (sets.empty() || ranges::any_of(sets, [](auto s) { return s->empty(); })) {
+            return ret;
+        }
+
+        using iterator = decltype(sets.front()->begin());
+
+        auto smallest = ranges::min(sets | views::transform([](auto s) { return s->size(); }));
+        vector<iterator> cur;
+        vector<bool> gallop;
+        for (auto s: sets) {
+            cur.push_back(s->begin());
+            gallop.push_back(cunits_detail::skewed(smallest, s->size()));
+        }
+
+        auto lo = sets.front()->begin()->min();
+
+        while (true) {
+            // raise lo until every input has an interval covering it
+            for (bool stable = false; !stable;) {
+                stable = true;
+                for (size_t n = 0; n < sets.size(); ++n) {
+                    cur[n] = cunits_detail::seek_past(*sets[n], cur[n], lo, gallop[n]);
+                    if (cur[n] == sets[n]->end()) {
+                        return ret;
+                    }
+                    if (lo < cur[n]->min()) {
+                        lo = cur[n]->min();
+                        stable = false;
+                    }
+                }
+            }
+
+            auto hi = ranges::min(cur | views::transform([](auto i) { return i->max(); }));
+            ret.append({lo, hi});
+            lo = hi;
+        }
+    }
+
+    // Unites all sets in a single sweep, always taking the next interval
+    // from a min-heap of the input cursors.  O(N log k).
+    template<typename T>
+    set<cunits<T>> union_all(span<const set<cunits<T>> *const> sets) {
+        using iterator = decltype(sets.front()->begin());
+        using cursor = pair<iterator, iterator>;
+
+        auto later = [](const cursor &lhs, const cursor &rhs) {
+            return rhs.first->min() < lhs.first->min();
+        };
+
+        vector<cursor> heap;
+        for (auto s: sets) {
+            if (!s->empty()) {
+                heap.emplace_back(s->begin(), s->end());
+            }
+        }
+        ranges::make_heap(heap, later);
+
+        set<cunits<T>> ret;
+
+        while (!heap.empty()) {
+            ranges::pop_heap(heap, later);
+            auto &[i, last] = heap.back();
+            ret.append(*i);
+
+            if (++i == last) {
+                heap.pop_back();
+            } else {
+                ranges::push_heap(heap, later);
+            }
+        }
+
+        return ret;
+    }
+
+    // Parallel tree reduction for large fan-ins: the halves are reduced
+    // with the given launch policy and joined pairwise.
+    template<typename T>
+    set<cunits<T>> intersect_all(span<const set<cunits<T>> *const> sets, launch policy) {
+        if (sets.size() <= cunits_detail::reduction_leaf) {
+            return intersect_all(sets);
+        }
+
+        auto half = sets.size() / 2;
+        auto lhs = async(policy, [=] { return intersect_all(sets.first(half), policy); });
+        auto rhs = intersect_all(sets.subspan(half), policy);
+
+        return intersection(lhs.get(), rhs);
+    }
+
+    template<typename T>
+    set<cunits<T>> union_all(span<const set<cunits<T>> *const> sets, launch policy) {
+        if (sets.size() <= cunits_detail::reduction_leaf) {
+            return union_all(sets);
+        }
+
+        auto half = sets.size() / 2;
+        auto lhs = async(policy, [=] { return union_all(sets.first(half), policy); });
+        auto rhs = union_all(sets.subspan(half), policy);
+
+        return union_of(lhs.get(), rhs);
+    }
+
+    // Tests one candidate against many supersets, writing whether each of
+    // them includes it.  The candidate's bounds are computed once and
+    // reject most supersets before any merge walk.  Returns the number of
+    // supersets including the candidate.
+    template<typename T>
+    size_t included_in(const set<cunits<T>> &candidate, span<const set<cunits<type_identity_t<T>>> *const> supersets,
+                       span<bool> result) {
+        assert(result.size() == supersets.size());
+
+        if (candidate.empty()) {
+            ranges::fill(result, true);
+            return result.size();
+        }
+
+        auto min = candidate.begin()->min();
+        auto max = prev(candidate.end())->max();
+        size_t count = 0;
+
+        for (size_t n = 0; n < supersets.size(); ++n) {
+            const auto &s = *supersets[n];
+            result[n] = !s.empty() && s.begin()->min() <= min && max <= prev(s.end())->max() && s.includes(candidate);
+            count += result[n];
+        }
+
+        return count;
+    }
+
+    template<typename T>
+    set<cunits<T>> intersect_all(initializer_list<const set<cunits<T>> *> sets) {
+        return intersect_all(span(sets.begin(), sets.size()));
+    }
+
+    template<typename T>
+    set<cunits<T>> union_all(initializer_list<const set<cunits<T>> *> sets) {
+        return union_all(span(sets.begin(), sets.size()));
+    }
+
+    // ============================= SET EXPRESSIONS =============================
+
+    namespace cunits_detail {
+        template<typename X>
+        inline constexpr bool is_cunits_set = false;
+
+        template<typename T>
+        inline constexpr bool is_cunits_set<set<cunits<T>>> = true;
+
+        template<typename X>
+        concept operand = is_cunits_set<X> || is_expression<X>;
+
+        template<typename X>
+        concept operand_ref = operand<remove_cvref_t<X>>;
+
+        template<operand_ref X>
+        auto as_operand(X &&x) {
+            using U = remove_cvref_t<X>;
+            if constexpr (is_expression<U>) {
+                return U(std::forward<X>(x));
+            } else if constexpr (is_lvalue_reference_v<X>) {
+                return set_operand<U>{&x};
+            } else {
+                return owned_set_operand<U>{std::move(x)};
+            }
+        }
+
+        template<template<typename, typename> typename Cursor, typename L, typename R>
+        auto make_expression(L &&lhs, R &&rhs) {
+            auto l = as_operand(std::forward<L>(lhs));
+            auto r = as_operand(std::forward<R>(rhs));
+            return expression<Cursor, decltype(l), decltype(r)>(std::move(l), std::move(r));
+        }
+    }
+
+    // a & b, a | b and a - b build lazy expressions over sets and other
+    // expressions; convert to a set to materialize the result.  Named sets
+    // are referred to, temporaries are moved into the expression.
+
+    template<cunits_detail::operand_ref L, cunits_detail::operand_ref R>
+    auto operator&(L &&lhs, R &&rhs) {
+        return cunits_detail::make_expression<cunits_detail::intersection_cursor>(std::forward<L>(lhs), std::forward<R>(rhs));
+    }
+
+    template<cunits_detail::operand_ref L, cunits_detail::operand_ref R>
+    auto operator|(L &&lhs, R &&rhs) {
+        return cunits_detail::make_expression<cunits_detail::union_cursor>(std::forward<L>(lhs), std::forward<R>(rhs));
+    }
+
+    template<cunits_detail::operand_ref L, cunits_detail::operand_ref R>
+    auto operator-(L &&lhs, R &&rhs) {
+        return cunits_detail::make_expression<cunits_detail::difference_cursor>(std::forward<L>(lhs), std::forward<R>(rhs));
+    }
+
+}
@@ -3,11 +3,600 @@
 #include <vector>
 #include <set>
 #include <numeric>
+#include <utility>
 #include <initializer_list>
+#include <iterator>
+#include <array>
+#include <bit>
 #include <algorithm>
+#include <future>
+#include <ranges>
+#include <span>
+#include <thread>
+#include <optional>
+#include <limits>
+#include <cstdint>
+#include <cmath>
+#include <random>
+#include <atomic>
+#include <mutex>
 #include "cunits.hpp"
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SPEC_VEC_SIMD
+#include <immintrin.h>
+#endif
+
 namespace std {
+    namespace cunits_detail {
+        // Sets whose sizes differ by more than this factor are merged by
+        // galloping through the larger one instead of walking it linearly.
+        inline constexpr size_t gallop_ratio = 8;
+
+        // Fan-ins up to this many sets are reduced in a single sweep.
+        inline constexpr size_t reduction_leaf = 8;
+
+        inline bool skewed(size_t small, size_t large) {
+            return small * gallop_ratio < large;
+        }
+
+        // Unsorted lookups run this many searches side by side so that
+        // their cache misses overlap.
+        inline constexpr size_t lookup_lanes = 16;
+
+        // Gap sampling gives up drawing after this many draws land in gaps
+        // that are too small, and lists the candidates instead.
+        inline constexpr int sample_attempts = 16;
+
+        // Keeps the k largest of the units offered to it, the lowest first
+        // among equals, in a heap whose top is the worst one kept.
+        template<typename T>
+        class top_k {
+            size_t m_k;
+            vector<cunits<T>> m_heap;
+
+            static bool better(const cunits<T> &a, const cunits<T> &b) {
+                return a.size() != b.size() ? a.size() > b.size() : a.min() < b.min();
+            }
+
+        public:
+            explicit top_k(size_t k) : m_k(k) {
+            }
+
+            bool full() const {
+                return m_heap.size() == m_k;
+            }
+
+            // The smallest size kept; only meaningful once full().
+            T worst() const {
+                return m_heap.front().size();
+            }
+
+            void offer(const cunits<T> &cu) {
+                if (m_heap.size() < m_k) {
+                    m_heap.push_back(cu);
+                    push_heap(m_heap.begin(), m_heap.end(), better);
+                } else if (m_k && better(cu, m_heap.front())) {
+                    pop_heap(m_heap.begin(), m_heap.end(), better);
+                    m_heap.back() = cu;
+                    push_heap(m_heap.begin(), m_heap.end(), better);
+                }
+            }
+
+            // The kept units, best first.
+            vector<cunits<T>> take() && {
+                sort_heap(m_heap.begin(), m_heap.end(), better);
+                return std::move(m_heap);
+            }
+        };
+
+        // Covered units below ascending keys x, counted from the interval
+        // the cursor starts at, so only differences between answers mean
+        // anything.  Each call moves past the intervals ending by x, making
+        // a run of calls one linear sweep.
+        template<typename It, typename T>
+        class measure_cursor {
+            It m_i;
+            It m_last;
+            T m_before{};
+
+        public:
+            measure_cursor(It first, It last) : m_i(first), m_last(last) {
+            }
+
+            T operator()(const T &x) {
+                while (m_i != m_last && m_i->max() <= x) {
+                    m_before += m_i->size();
+                    ++m_i;
+                }
+                return m_i != m_last && m_i->min() < x ? m_before + (x - m_i->min()) : m_before;
+            }
+        };
+
+        // Defined with the other set algebra kernels below.
+        template<typename L, typename R, typename Out>
+        void union_into(const L &lhs, const R &rhs, Out &out);
+
+        // Defined with the parallel set algebra below.
+        template<typename T, typename Kernel>
+        set<cunits<T>> partitioned(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs, launch policy,
+                                   size_t threads, Kernel kernel);
+
+        // Sorts units by lower endpoint and merges the ones that overlap or
+        // touch, dropping empty ones, in place.
+        template<typename T>
+        void coalesce(vector<cunits<T>> &units) {
+            erase_if(units, [](const cunits<T> &cu) { return cu.empty(); });
+            ranges::sort(units, {}, [](const cunits<T> &cu) { return cu.min(); });
+
+            size_t n = 0;
+            for (const auto &cu: units) {
+                if (n && cu.min() <= units[n - 1].max()) {
+                    units[n - 1] = cunits<T>(units[n - 1].min(), std::max(units[n - 1].max(), cu.max()));
+                } else {
+                    units[n++] = cu;
+                }
+            }
+            units.resize(n);
+        }
+
+        // A uniformly random value in [0, n).
+        template<typename T, typename R>
+        T draw(R &rng, const T &n) {
+            if constexpr (is_integral_v<T>) {
+                return uniform_int_distribution<T>(0, n - 1)(rng);
+            } else {
+                return uniform_real_distribution<T>(0, n)(rng);
+            }
+        }
+
+        inline void prefetch(const void *p) {
+#if defined(__GNUC__) || defined(__clang__)
+            __builtin_prefetch(p);
+#endif
+        }
+
+        // One bit per block of 2^shift consecutive values, set when some
+        // value of the block is covered, so that a clear bit proves a miss
+        // without touching the intervals.  The bits span the blocks between
+        // the lowest and highest ever covered, 2^shift values per bit.
+        template<typename T>
+        class presence_summary {
+            unsigned m_shift;
+            int64_t m_first = 0;
+            vector<uint64_t> m_words;
+
+        public:
+            explicit presence_summary(unsigned shift) : m_shift(shift) {
+            }
+
+            int64_t block(const T &v) const {
+                if constexpr (is_integral_v<T>) {
+                    return static_cast<int64_t>(v >> m_shift);
+                } else {
+                    return static_cast<int64_t>(floor(ldexp(v, -static_cast<int>(m_shift))));
+                }
+            }
+
+            T block_start(int64_t b) const {
+                if constexpr (is_integral_v<T>) {
+                    return static_cast<T>(b) << m_shift;
+                } else {
+                    return ldexp(static_cast<T>(b), static_cast<int>(m_shift));
+                }
+            }
+
+            bool test(const T &v) const {
+                auto b = block(v) - m_first;
+                return b >= 0 && b < static_cast<int64_t>(m_words.size()) * 64 && (m_words[b / 64] >> b % 64 & 1);
+            }
+
+            // Sets or clears the bits of blocks [first, last].
+            void assign(int64_t first, int64_t last, bool on) {
+                if (on) {
+                    reserve(first, last);
+                } else {
+                    first = std::max(first, m_first);
+                    last = std::min(last, m_first + static_cast<int64_t>(m_words.size()) * 64 - 1);
+                }
+
+                for (auto b = first; b <= last;) {
+                    auto word = (b - m_first) / 64;
+                    auto from = (b - m_first) % 64;
+                    auto to = std::min<int64_t>(63, from + (last - b));
+                    auto mask = (~uint64_t(0) >> (63 - to)) & (~uint64_t(0) << from);
+                    m_words[word] = on ? m_words[word] | mask : m_words[word] & ~mask;
+                    b += to - from + 1;
+                }
+            }
+
+            void clear() {
+                m_words.clear();
+            }
+
+        private:
+            // Grows the bits to span blocks [first, last], keeping m_first a
+            // multiple of 64 so that growing at the front moves whole words.
+            void reserve(int64_t first, int64_t last) {
+                if (m_words.empty()) {
+                    m_first = first >> 6 << 6;
+                }
+                if (first < m_first) {
+                    auto grow = (m_first - (first >> 6 << 6)) / 64;
+                    m_words.insert(m_words.begin(), grow, 0);
+                    m_first -= grow * 64;
+                }
+                if (auto words = (last - m_first) / 64 + 1; words > static_cast<int64_t>(m_words.size())) {
+                    m_words.resize(words);
+                }
+            }
+        };
+
+#ifdef SPEC_VEC_SIMD
+        namespace simd {
+            inline bool contains(const cunits<int> *data, const int *pos, const int *x, uint16_t &mask);
+        }
+#endif
+
+        // Returns the first interval in [from, s.end()) that ends after v.
+        // With gallop set, the skipped run is found by exponential search
+        // in O(log d), where d is its length; otherwise by a linear walk.
+        template<typename S, typename It, typename V>
+        It seek_past(const S &s, It from, const V &v, bool gallop) {
+            auto last = s.end();
+            auto before = [&v](const auto &cu) { return cu.max() <= v; };
+
+            if (!gallop) {
+                while (from != last && before(*from)) {
+                    ++from;
+                }
+                return from;
+            }
+
+            typename iterator_traits<It>::difference_type step = 1;
+            while (last - from > step && before(from[step])) {
+                from += step;
+                step *= 2;
+            }
+            return partition_point(from, last - from > step ? from + step + 1 : last, before);
+        }
+
+        // Samples parts - 1 partition boundaries from s, evenly spaced by
+        // position; the outer bounds are left for the caller to fill in.
+        template<typename S>
+        auto sample_bounds(const S &s, size_t parts) {
+            vector<remove_cvref_t<decltype(s.begin()->min())>> bounds(parts + 1);
+            for (size_t p = 1; p < parts; ++p) {
+                bounds[p] = s.begin()[s.size() * p / parts].min();
+            }
+            return bounds;
+        }
+
+        // ============================= LAZY EXPRESSIONS =============================
+
+        // A cursor streams the sorted, disjoint units of a set or of a set
+        // expression: front() is the current unit and pop() moves past it.
+        // Composite cursors compute the next unit of the result eagerly, so
+        // pop() is where the work happens.
+
+        template<typename It>
+        class set_cursor {
+            It m_cur;
+            It m_last;
+
+        public:
+            set_cursor(It first, It last) : m_cur(first), m_last(last) {
+            }
+
+            bool valid() const {
+                return m_cur != m_last;
+            }
+
+            auto front() const {
+                return *m_cur;
+            }
+
+            void pop() {
+                ++m_cur;
+            }
+        };
+
+        template<typename L, typename R>
+        class intersection_cursor {
+            L m_lhs;
+            R m_rhs;
+            decltype(m_lhs.front()) m_front;
+            bool m_valid = false;
+
+            void settle() {
+                while (m_lhs.valid() && m_rhs.valid()) {
+                    auto i = m_lhs.front();
+                    auto j = m_rhs.front();
+
+                    if (i.max() <= j.min()) {
+                        m_lhs.pop();
+                        continue;
+                    }
+
+                    if (j.max() <= i.min()) {
+                        m_rhs.pop();
+                        continue;
+                    }
+
+                    m_front = {std::max(i.min(), j.min()), std::min(i.max(), j.max())};
+                    m_valid = true;
+
+                    if (i.max() < j.max()) {
+                        m_lhs.pop();
+                    } else {
+                        m_rhs.pop();
+                    }
+                    return;
+                }
+
+                m_valid = false;
+            }
+
+        public:
+            intersection_cursor(L lhs, R rhs) : m_lhs(std::move(lhs)), m_rhs(std::move(rhs)) {
+                settle();
+            }
+
+            bool valid() const {
+                return m_valid;
+            }
+
+            auto front() const {
+                return m_front;
+            }
+
+            void pop() {
+                settle();
+            }
+        };
+
+        template<typename L, typename R>
+        class union_cursor {
+            L m_lhs;
+            R m_rhs;
+            decltype(m_lhs.front()) m_front;
+            bool m_valid = false;
+
+            void settle() {
+                if (!m_lhs.valid() && !m_rhs.valid()) {
+                    m_valid = false;
+                    return;
+                }
+
+                auto take = [](auto &cursor) {
+                    auto cu = cursor.front();
+                    cursor.pop();
+                    return cu;
+                };
+
+                bool left = !m_rhs.valid() || (m_lhs.valid() && m_lhs.front().min() < m_rhs.front().min());
+                auto cu = left ? take(m_lhs) : take(m_rhs);
+                auto max = cu.max();
+
+                // swallow everything overlapping or touching the unit
+                for (bool grown = true; grown;) {
+                    grown = false;
+                    if (m_lhs.valid() && m_lhs.front().min() <= max) {
+                        max = std::max(max, take(m_lhs).max());
+                        grown = true;
+                    }
+                    if (m_rhs.valid() && m_rhs.front().min() <= max) {
+                        max = std::max(max, take(m_rhs).max());
+                        grown = true;
+                    }
+                }
+
+                m_front = {cu.min(), max};
+                m_valid = true;
+            }
+
+        public:
+            union_cursor(L lhs, R rhs) : m_lhs(std::move(lhs)), m_rhs(std::move(rhs)) {
+                settle();
+            }
+
+            bool valid() const {
+                return m_valid;
+            }
+
+            auto front() const {
+                return m_front;
+            }
+
+            void pop() {
+                settle();
+            }
+        };
+
+        template<typename L, typename R>
+        class difference_cursor {
+            L m_lhs;
+            R m_rhs;
+            decltype(m_lhs.front()) m_front;
+            bool m_valid = false;
+
+            // the front of lhs has been cut and continues from m_lo
+            bool m_cut = false;
+            remove_cvref_t<decltype(m_front.min())> m_lo{};
+
+            void settle() {
+                while (m_lhs.valid()) {
+                    auto i = m_lhs.front();
+                    auto lo = m_cut ? m_lo : i.min();
+
+                    while (m_rhs.valid() && m_rhs.front().max() <= lo) {
+                        m_rhs.pop();
+                    }
+
+                    if (!m_rhs.valid() || i.max() <= m_rhs.front().min()) {
+                        m_front = {lo, i.max()};
+                        m_valid = true;
+                        m_cut = false;
+                        m_lhs.pop();
+                        return;
+                    }
+
+                    auto j = m_rhs.front();
+
+                    if (j.max() < i.max()) {
+                        m_cut = true;
+                        m_lo = j.max();
+                    } else {
+                        m_cut = false;
+                        m_lhs.pop();
+                    }
+
+                    if (lo < j.min()) {
+                        m_front = {lo, j.min()};
+                        m_valid = true;
+                        return;
+                    }
+                }
+
+                m_valid = false;
+            }
+
+        public:
+            difference_cursor(L lhs, R rhs) : m_lhs(std::move(lhs)), m_rhs(std::move(rhs)) {
+                settle();
+            }
+
+            bool valid() const {
+                return m_valid;
+            }
+
+            auto front() const {
+                return m_front;
+            }
+
+            void pop() {
+                settle();
+            }
+        };
+
+        // A set operand of an expression, held by reference.
+        template<typename S>
+        struct set_operand {
+            const S *m_set;
+
+            auto cursor() const {
+                return set_cursor(m_set->begin(), m_set->end());
+            }
+        };
+
+        // A temporary set operand, moved into the expression so that it
+        // lives as long as the expression does.
+        template<typename S>
+        struct owned_set_operand {
+            S m_set;
+
+            auto cursor() const {
+                return set_cursor(m_set.begin(), m_set.end());
+            }
+        };
+
+        // A lazily evaluated combination of two operands.  Nothing is
+        // computed until the expression is iterated, counted, queried or
+        // converted to a set; each evaluation reads every input once in a
+        // single fused sweep and allocates nothing.  Like a view, it refers
+        // to the named sets it was built from and must not outlive them;
+        // temporary sets are kept inside it.
+        template<template<typename, typename> typename Cursor, typename L, typename R>
+        class expression {
+            L m_lhs;
+            R m_rhs;
+
+        public:
+            expression(L lhs, R rhs) : m_lhs(std::move(lhs)), m_rhs(std::move(rhs)) {
+            }
+
+            auto cursor() const {
+                return Cursor(m_lhs.cursor(), m_rhs.cursor());
+            }
+
+            using cursor_type = decltype(declval<const expression &>().cursor());
+            using data_type = decltype(declval<cursor_type>().front());
+            using value_type = remove_cvref_t<decltype(declval<data_type>().min())>;
+
+            class iterator {
+                cursor_type m_cursor;
+
+            public:
+                using value_type = expression::data_type;
+                using difference_type = ptrdiff_t;
+
+                explicit iterator(cursor_type cursor) : m_cursor(std::move(cursor)) {
+                }
+
+                value_type operator*() const {
+                    return m_cursor.front();
+                }
+
+                iterator &operator++() {
+                    m_cursor.pop();
+                    return *this;
+                }
+
+                void operator++(int) {
+                    m_cursor.pop();
+                }
+
+                bool operator==(default_sentinel_t) const {
+                    return !m_cursor.valid();
+                }
+            };
+
+            iterator begin() const {
+                return iterator(cursor());
+            }
+
+            default_sentinel_t end() const {
+                return default_sentinel;
+            }
+
+            [[nodiscard]] bool empty() const {
+                return !cursor().valid();
+            }
+
+            size_t size() const {
+                size_t result = 0;
+                for (auto c = cursor(); c.valid(); c.pop()) {
+                    ++result;
+                }
+                return result;
+            }
+
+            bool contains(const data_type &cu) const {
+                for (auto c = cursor(); c.valid(); c.pop()) {
+                    if (cu.min() < c.front().max()) {
+                        return c.front().includes(cu);
+                    }
+                }
+                return false;
+            }
+
+            bool contains(const value_type &value) const {
+                for (auto c = cursor(); c.valid(); c.pop()) {
+                    if (value < c.front().max()) {
+                        return c.front().contains(value);
+                    }
+                }
+                return false;
+            }
+        };
+
+        template<typename X>
+        inline constexpr bool is_expression = false;
+
+        template<template<typename, typename> typename Cursor, typename L, typename R>
+        inline constexpr bool is_expression<expression<Cursor, L, R>> = true;
+    }
+
     template<typename T>
     class set<cunits<T>> {
     private:
@@ -21,313 +610,2317 @@ namespace std {
             }
         };
 
-        using adapted_type = vector<data_type>;
-        adapted_type m_cus;
+        using adapted_type = vector<data_type>;
+        adapted_type m_cus;
+
+        // total number of covered units
+        T m_cardinality{};
+
+        // m_prefix[i] is the number of units covered by the first i
+        // intervals; it is rebuilt lazily, once m_prefix_valid is off
+        mutable vector<T> m_prefix;
+        mutable atomic<bool> m_prefix_valid = false;
+
+        // max segment tree over the gaps between neighbouring intervals,
+        // leaves from index m_gaps.size() / 2 on; rebuilt lazily like
+        // m_prefix
+        mutable vector<T> m_gaps;
+        mutable atomic<bool> m_gaps_valid = false;
+
+        // serializes the lazy rebuilds, so that const queries may run
+        // concurrently even right after a modification
+        mutable mutex m_rebuild;
+
+        void changed(const T &delta) {
+            m_cardinality += delta;
+            m_prefix_valid.store(false, memory_order_relaxed);
+            m_gaps_valid.store(false, memory_order_relaxed);
+        }
+
+        // Runs rebuild under the lock unless valid is already on.
+        template<typename F>
+        void refresh(atomic<bool> &valid, F rebuild) const {
+            if (!valid.load(memory_order_acquire)) {
+                lock_guard lock(m_rebuild);
+                if (!valid.load(memory_order_relaxed)) {
+                    rebuild();
+                    valid.store(true, memory_order_release);
+                }
+            }
+        }
+
+        const vector<T> &prefix() const {
+            refresh(m_prefix_valid, [this] {
+                m_prefix.resize(size() + 1);
+                m_prefix[0] = T{};
+                for (size_t k = 0; k < size(); ++k) {
+                    m_prefix[k + 1] = m_prefix[k] + m_cus[k].size();
+                }
+            });
+            return m_prefix;
+        }
+
+        const vector<T> &gaps() const {
+            refresh(m_gaps_valid, [this] {
+                size_t leaves = bit_ceil(std::max<size_t>(size(), 1));
+                m_gaps.assign(2 * leaves, T{});
+                for (size_t k = 0; k + 1 < size(); ++k) {
+                    m_gaps[leaves + k] = m_cus[k + 1].min() - m_cus[k].max();
+                }
+                for (size_t v = leaves - 1; v > 0; --v) {
+                    m_gaps[v] = std::max(m_gaps[2 * v], m_gaps[2 * v + 1]);
+                }
+            });
+            return m_gaps;
+        }
+
+        // First interval at or after a followed by a gap of at least k.
+        auto gap_after(typename adapted_type::const_iterator a, const T &k) const {
+            const auto &tree = gaps();
+            size_t leaves = tree.size() / 2;
+
+            // climb until a subtree at or right of a has a wide enough
+            // gap, then descend to its leftmost one
+            for (size_t v = leaves + (a - begin());; ++v) {
+                if (tree[v] >= k) {
+                    while (v < leaves) {
+                        v = tree[2 * v] >= k ? 2 * v : 2 * v + 1;
+                    }
+                    return begin() + (v - leaves);
+                }
+                while (v & 1) {
+                    v >>= 1;
+                }
+                if (v == 0) {
+                    return end();
+                }
+            }
+        }
+
+        // Last interval at or before b preceded by a gap of at least k.
+        auto gap_before(typename adapted_type::const_iterator b, const T &k) const {
+            if (b == begin()) {
+                return end();
+            }
+
+            const auto &tree = gaps();
+            size_t leaves = tree.size() / 2;
+
+            for (size_t v = leaves + (b - begin() - 1);; --v) {
+                if (tree[v] >= k) {
+                    while (v < leaves) {
+                        v = tree[2 * v + 1] >= k ? 2 * v + 1 : 2 * v;
+                    }
+                    return begin() + (v - leaves + 1);
+                }
+                while (v > 1 && !(v & 1)) {
+                    v >>= 1;
+                }
+                if (v == 1) {
+                    return end();
+                }
+            }
+        }
+
+        // The interval ending the gap that holds the k-th uncovered unit
+        // after the first interval, counting from 0.
+        auto gap_select(const T &k) const {
+            const auto &sums = prefix();
+            auto first = begin()->min();
+            return partition_point(begin() + 1, end(), [&](const data_type &cu) {
+                return cu.min() - first - sums[&cu - m_cus.data()] <= k;
+            });
+        }
+
+        // Number of covered units below x.
+        T measure_below(const T &x) const {
+            auto i = ranges::partition_point(m_cus, [&](const data_type &cu) { return cu.max() <= x; });
+            auto result = prefix()[i - begin()];
+            return i != end() && i->min() < x ? result + (x - i->min()) : result;
+        }
+
+        // gaps between neighbouring intervals as (size, lower endpoint),
+        // kept only after enable_gap_index()
+        optional<set<pair<T, T>>> m_gap_index;
+
+        // Adds to or drops from the gap index every gap touching region,
+        // which are the only gaps a modification of region can change.
+        void index_gaps(const data_type &region, bool add) {
+            if (!m_gap_index) {
+                return;
+            }
+
+            auto y = upper_bound(data_type(region.min(), region.min()));
+            if (y != end() && y == begin()) {
+                ++y;
+            }
+
+            for (; y != end(); ++y) {
+                auto x = prev(y);
+                if (x->max() > region.max()) {
+                    break;
+                }
+
+                pair gap(y->min() - x->max(), x->max());
+                if (add) {
+                    m_gap_index->insert(gap);
+                } else {
+                    m_gap_index->erase(gap);
+                }
+            }
+        }
+
+        // coarse presence bits, kept only after enable_summary()
+        optional<cunits_detail::presence_summary<T>> m_summary;
+
+        // Refreshes the summary over region once it has become covered or
+        // uncovered; of the blocks region touches, only the two at its ends
+        // can also hold other intervals.
+        void summarize(const data_type &region, bool covered) {
+            if (!m_summary || region.empty()) {
+                return;
+            }
+
+            auto first = m_summary->block(region.min());
+            auto last = m_summary->block(region.max());
+            if (m_summary->block_start(last) == region.max()) {
+                --last;
+            }
+
+            m_summary->assign(first, last, covered);
+            if (!covered) {
+                for (auto b: {first, last}) {
+                    auto from = m_summary->block_start(b);
+                    auto i = lower_bound(data_type(from, from));
+                    m_summary->assign(b, b, i != end() && m_summary->block(i->min()) <= b);
+                }
+            }
+        }
+
+        using const_iterator = typename adapted_type::const_iterator;
+
+        // Navigation answers for x, given i, the first interval ending
+        // after x.
+
+        optional<value_type> next_covered_from(const_iterator i, const value_type &x) const {
+            if (i == end()) {
+                return nullopt;
+            }
+            return std::max(x, i->min());
+        }
+
+        optional<value_type> prev_covered_from(const_iterator i, const value_type &x) const {
+            if (i != end() && i->min() <= x) {
+                return x;
+            }
+            if (i == begin()) {
+                return nullopt;
+            }
+            return prev(i)->max() - 1;
+        }
+
+        data_type next_gap_from(const_iterator i, const value_type &x) const {
+            auto from = x;
+            if (i != end() && i->min() <= x) {
+                from = (i++)->max();
+            }
+            return data_type(from, i == end() ? numeric_limits<T>::max() : i->min());
+        }
+
+        optional<value_type> run_end_from(const_iterator i, const value_type &x) const {
+            if (i != end() && i->min() <= x) {
+                return i->max();
+            }
+            return nullopt;
+        }
+
+        // Answers the ascending queries xs with one cursor, galloping when
+        // there are far fewer queries than intervals.
+        template<typename R, typename F>
+        void navigate(span<const value_type> xs, span<R> result, F answer) const {
+            assert(xs.size() == result.size());
+            assert(ranges::is_sorted(xs));
+
+            bool gallop = cunits_detail::skewed(xs.size(), size());
+            auto i = begin();
+
+            for (size_t q = 0; q < xs.size(); ++q) {
+                i = cunits_detail::seek_past(*this, i, xs[q], gallop);
+                result[q] = answer(i, xs[q]);
+            }
+        }
+
+        // with enable_finger(), lookups and inserts start from the last
+        // position they touched, kept as a relaxed atomic since const
+        // lookups move it too
+        bool m_finger = false;
+        mutable atomic<size_t> m_finger_at = 0;
+
+        const_iterator finger() const {
+            return begin() + std::min(m_finger_at.load(memory_order_relaxed), size());
+        }
+
+        void remember(const_iterator i) const {
+            if (m_finger) {
+                m_finger_at.store(i - begin(), memory_order_relaxed);
+            }
+        }
+
+        // First interval ending after v, searched by galloping out from
+        // hint in O(log d), where d is the distance to the result.
+        const_iterator lower_bound_from(const_iterator hint, const value_type &v) const {
+            auto before = [&v](const data_type &cu) { return cu.max() <= v; };
+            if (hint != end() && before(*hint)) {
+                return cunits_detail::seek_past(*this, hint, v, true);
+            }
+
+            auto first = begin();
+            for (ptrdiff_t step = 1; hint != first; step *= 2) {
+                auto probe = hint - std::min(step, hint - first);
+                if (before(*probe)) {
+                    first = probe + 1;
+                    break;
+                }
+                hint = probe;
+            }
+            return partition_point(first, hint, before);
+        }
+
+        // First interval starting at or after v, searched from hint.
+        const_iterator upper_bound_from(const_iterator hint, const value_type &v) const {
+            auto i = lower_bound_from(hint, v);
+            return i != end() && i->min() < v ? ++i : i;
+        }
+
+        // Inserts new_cu given i, the first interval starting at or after
+        // its end.  The run of intervals new_cu overlaps or touches is found
+        // by a search back from i and replaced by their union with one range
+        // erase and one insert, in O(log n + k) for a run of k.
+        const_iterator insert_at(const_iterator i, const data_type &new_cu) {
+            if (new_cu.empty()) {
+                return i;
+            }
+
+            // the run starts at the first interval ending at or after
+            // new_cu and ends with the one starting at its end, if any
+            auto first = lower_bound_from(i, new_cu.min());
+            if (first != begin() && prev(first)->max() == new_cu.min()) {
+                --first;
+            }
+
+            auto last = i;
+            if (last != end() && last->min() == new_cu.max()) {
+                ++last;
+            }
+
+            if (first != last && next(first) == last && first->includes(new_cu)) {
+                remember(first);
+                return first;
+            }
+
+            auto min = first != last ? std::min(first->min(), new_cu.min()) : new_cu.min();
+            auto max = first != last ? std::max(prev(last)->max(), new_cu.max()) : new_cu.max();
+            data_type insert_cu(min, max);
+
+            auto delta = insert_cu.size();
+            for (auto k = first; k != last; ++k) {
+                delta -= k->size();
+            }
+
+            index_gaps(insert_cu, false);
+            auto pos = m_cus.insert(m_cus.erase(first, last), insert_cu);
+            changed(delta);
+            index_gaps(insert_cu, true);
+            summarize(new_cu, true);
+            remember(pos);
+
+            assert(*pos == insert_cu);
+            assert(verify());
+            return pos;
+        }
+
+        // Lower bounds of the values x, at most lookup_lanes of them, in a
+        // non-empty set.  The branch-free binary searches advance in
+        // lockstep, each prefetching its next probe, so that their cache
+        // misses overlap.
+        void lower_bounds(span<const value_type> x, size_t *pos) const {
+            const data_type *base[cunits_detail::lookup_lanes];
+            fill_n(base, x.size(), m_cus.data());
+
+            // every search has the same length left, so one loop drives
+            // them all
+            for (size_t len = size(); len > 1;) {
+                size_t half = len / 2;
+                len -= half;
+                for (size_t g = 0; g < x.size(); ++g) {
+                    base[g] = base[g][half].max() <= x[g] ? base[g] + half : base[g];
+                    cunits_detail::prefetch(base[g] + len / 2);
+                }
+            }
+
+            for (size_t g = 0; g < x.size(); ++g) {
+                pos[g] = (base[g] - m_cus.data()) + (base[g]->max() <= x[g]);
+            }
+        }
+
+        // Inserts a sorted, coalesced batch: appended when it starts past
+        // the last interval, merged with the contents in one pass otherwise.
+        void insert_batch(vector<data_type> batch) {
+            if (batch.empty()) {
+                return;
+            }
+
+            if (empty() || prev(end())->max() <= batch.front().min()) {
+                append(batch.begin(), batch.end());
+                return;
+            }
+
+            set sorted;
+            sorted.append(batch.begin(), batch.end());
+            set merged;
+            cunits_detail::union_into(*this, sorted, merged);
+            adopt(std::move(merged));
+        }
+
+        // Removes cu from the run [first, last) of intervals it overlaps,
+        // keeping the parts of the end intervals that stick out.  The run is
+        // overwritten by those at most two pieces and closed up with one
+        // shift.
+        void erase_run(const_iterator first, const_iterator last, const data_type &cu) {
+            if (first == last || cu.empty()) {
+                return;
+            }
+
+            data_type region(first->min(), prev(last)->max());
+            data_type pieces[2];
+            size_t count = 0;
+            if (region.min() < cu.min()) {
+                pieces[count++] = data_type(region.min(), cu.min());
+            }
+            if (cu.max() < region.max()) {
+                pieces[count++] = data_type(cu.max(), region.max());
+            }
+
+            T removed{};
+            for (auto k = first; k != last; ++k) {
+                removed -= k->size();
+            }
+            for (size_t k = 0; k < count; ++k) {
+                removed += pieces[k].size();
+            }
+
+            index_gaps(region, false);
+            auto pos = static_cast<size_t>(first - begin());
+            auto at = m_cus.begin() + pos;
+            auto run = static_cast<size_t>(last - first);
+            if (count <= run) {
+                copy_n(pieces, count, at);
+                m_cus.erase(at + count, at + run);
+            } else {
+                *at = pieces[0];
+                m_cus.insert(at + 1, pieces[1]);
+            }
+            changed(removed);
+            index_gaps(region, true);
+            summarize(cu, false);
+            remember(begin() + pos);
+            assert(verify());
+        }
+
+        // The ascending values as a set of runs.
+        static set runs_of(span<const value_type> values) {
+            assert(ranges::is_sorted(values));
+
+            set runs;
+            for (const auto &value: values) {
+                runs.append(data_type(value, value + 1));
+            }
+            return runs;
+        }
+
+        // Takes sorted, disjoint units that cover cardinality units.
+        set(vector<data_type> &&units, const T &cardinality) : m_cus(std::move(units)), m_cardinality(cardinality) {
+            assert(verify());
+        }
+
+        template<typename U, typename Kernel>
+        friend set<cunits<U>> cunits_detail::partitioned(const set<cunits<U>> &lhs, const set<cunits<U>> &rhs,
+                                                         launch policy, size_t threads, Kernel kernel);
+
+        // Takes over the intervals of other, rebuilding the optional
+        // indexes over them.
+        void adopt(set &&other) {
+            changed(other.m_cardinality - m_cardinality);
+            m_cus = std::move(other.m_cus);
+            reindex();
+        }
+
+        // Rebuilds the optional indexes over the current intervals.
+        void reindex() {
+            if (m_gap_index) {
+                m_gap_index->clear();
+                if (!empty()) {
+                    index_gaps(data_type(begin()->min(), prev(end())->max()), true);
+                }
+            }
+
+            if (m_summary) {
+                m_summary->clear();
+                for (const auto &cu: *this) {
+                    summarize(cu, true);
+                }
+            }
+        }
+
+        bool verify()
+        {
+            if (auto i = begin(); i != end())
+                for (auto p = i; ++i != end(); ++p)
+                    if (p->max() > i->min())
+                        return false;
+
+            return true;
+        }
+
+    public:
+        // ============================= CONSTRUCTORS =============================
+
+        set() = default;
+
+        set(initializer_list<data_type> initializer_list) {
+            insert(initializer_list.begin(), initializer_list.end());
+        }
+
+        // Loads the units [first, last), in any order and possibly
+        // overlapping, with one sort.
+        template<input_iterator It>
+        set(It first, It last) {
+            insert(first, last);
+        }
+
+        // Materializes a set expression in a single sweep.
+        template<typename E> requires cunits_detail::is_expression<E>
+        set(const E &expression) {
+            for (const auto &cu: expression) {
+                append(cu);
+            }
+        }
+
+        // The lazy caches are not copied, since other may be rebuilding
+        // them in a concurrent const query.
+        set(const set &other)
+                : m_cus(other.m_cus), m_cardinality(other.m_cardinality),
+                  m_gap_index(other.m_gap_index), m_summary(other.m_summary),
+                  m_finger(other.m_finger), m_finger_at(other.m_finger_at.load(memory_order_relaxed)) {
+        }
+
+        set(set &&other) noexcept
+                : m_cus(std::move(other.m_cus)), m_cardinality(std::exchange(other.m_cardinality, T{})),
+                  m_prefix(std::move(other.m_prefix)), m_prefix_valid(other.m_prefix_valid.exchange(false)),
+                  m_gaps(std::move(other.m_gaps)), m_gaps_valid(other.m_gaps_valid.exchange(false)),
+                  m_gap_index(std::move(other.m_gap_index)), m_summary(std::move(other.m_summary)),
+                  m_finger(other.m_finger), m_finger_at(other.m_finger_at.load(memory_order_relaxed)) {
+        }
+
+        // ============================= OPERATORS =============================
+
+        set &operator=(const set &other) {
+            return *this = set(other);
+        }
+
+        set &operator=(set &&other) noexcept {
+            if (this == &other) {
+                return *this;
+            }
+
+            m_cus = std::move(other.m_cus);
+            m_cardinality = std::exchange(other.m_cardinality, T{});
+            m_prefix = std::move(other.m_prefix);
+            m_prefix_valid = other.m_prefix_valid.exchange(false);
+            m_gaps = std::move(other.m_gaps);
+            m_gaps_valid = other.m_gaps_valid.exchange(false);
+            m_gap_index = std::move(other.m_gap_index);
+            m_summary = std::move(other.m_summary);
+            m_finger = other.m_finger;
+            m_finger_at.store(other.m_finger_at.load(memory_order_relaxed), memory_order_relaxed);
+            return *this;
+        }
+
+        bool operator < (const set<cunits<T>> &rhs) const {
+            return static_cast<adapted_type>(*this) < static_cast<adapted_type>(rhs);
+        }
+
+        bool operator()(const data_type &lhs, const data_type &rhs) const {
+            return lhs.max() <= rhs.min();
+        }
+
+        bool operator == (const set<cunits<T>> &rhs) const {
+            if (size() != rhs.size()) {
+                return false;
+            }
+
+            for(auto i = begin(), j = rhs.begin(); i != end(); ++i, ++j) {
+                if(*i != *j) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        // ============================= ITERATORS =============================
+
+        auto begin() const {
+            return m_cus.begin();
+        }
+
+        auto end() const {
+            return m_cus.end();
+        }
+
+        // ============================= CAPACITY =============================
+
+        [[nodiscard]] bool empty() const {
+            return m_cus.empty();
+        }
+
+        auto size() const {
+            return m_cus.size();
+        }
+
+        // Total number of covered units, maintained by every modifier.
+        T cardinality() const {
+            return m_cardinality;
+        }
+
+        // Number of covered units inside range, in O(log n) once the
+        // prefix sums are current.
+        T count_in_range(const data_type &range) const {
+            return measure_below(range.max()) - measure_below(range.min());
+        }
+
+        // Writes the covered units of each bucket_width-wide bucket of range
+        // to out, starting at range.min(); the last bucket is cut short at
+        // range.max() and out must hold them all.  One sweep over the
+        // intervals overlapping range, O(log n + k + buckets).
+        void coverage_histogram(const data_type &range, const T &bucket_width, span<T> out) const {
+            assert(bucket_width > 0);
+            assert(static_cast<T>(out.size()) * bucket_width >= range.size());
+
+            cunits_detail::measure_cursor<const_iterator, T> cursor(lower_bound(range), end());
+            auto from = range.min();
+            auto below = cursor(from);
+
+            for (size_t q = 0; q < out.size(); ++q) {
+                auto to = range.max() - from > bucket_width ? from + bucket_width : range.max();
+                auto next = cursor(to);
+                out[q] = next - below;
+                below = next;
+                from = to;
+            }
+        }
+
+        // Writes the covered units of the window [x, x + width) to out[q],
+        // where x = from + q * step, for every q < out.size().  Both window
+        // edges sweep the intervals once, so the cost is
+        // O(log n + k + windows) however much the windows overlap.
+        void sliding_coverage(const value_type &from, const T &width, const T &step, span<T> out) const {
+            assert(width > 0 && step > 0);
+
+            auto first = lower_bound(data_type(from, from));
+            cunits_detail::measure_cursor<const_iterator, T> lo(first, end());
+            cunits_detail::measure_cursor<const_iterator, T> hi(first, end());
+
+            auto x = from;
+            for (size_t q = 0; q < out.size(); ++q, x += step) {
+                out[q] = hi(x + width) - lo(x);
+            }
+        }
+
+        bool includes(const data_type &cu) const {
+            auto i = ranges::upper_bound(m_cus, cu, data_type_cmp());
+            return i != begin() && (--i)->includes(cu);
+        }
+
+        bool includes(const set<cunits<T>> &cus) const {
+            // walk both sequences once, galloping over this set when the
+            // argument is much smaller
+            bool gallop = cunits_detail::skewed(cus.size(), size());
+            auto i = begin();
+
+            for (const auto &cu: cus) {
+                i = cunits_detail::seek_past(*this, i, cu.min(), gallop);
+                if (i == end() || !i->includes(cu)) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        // ============================= MODIFIERS =============================
+
+        void clear() {
+            m_cus.clear();
+            changed(-m_cardinality);
+            if (m_gap_index) {
+                m_gap_index->clear();
+            }
+            if (m_summary) {
+                m_summary->clear();
+            }
+        }
+
+        void insert(const data_type &new_cu) {
+            insert_at(m_finger ? upper_bound_from(finger(), new_cu.max()) : upper_bound(new_cu), new_cu);
+        }
+
+        // Inserts new_cu with the search starting from hint; returns the
+        // interval that now holds it.
+        auto insert(const_iterator hint, const data_type &new_cu) {
+            return insert_at(upper_bound_from(hint, new_cu.max()), new_cu);
+        }
+
+        // Inserts the units [first, last), in any order and possibly
+        // overlapping.  The batch is sorted and coalesced on its own, then
+        // merged with the contents in one pass: O(n + m log m) for n
+        // intervals and m units, against a search and a shift per unit.
+        template<input_iterator It>
+        void insert(It first, It last) {
+            insert_range(ranges::subrange(first, last));
+        }
+
+        template<ranges::input_range R>
+        void insert_range(R &&units) {
+            vector<data_type> batch;
+            ranges::copy(units, back_inserter(batch));
+            cunits_detail::coalesce(batch);
+            insert_batch(std::move(batch));
+        }
+
+        // Appends a unit that starts no earlier than the last interval,
+        // merging with it when they overlap or touch.  Amortized O(1).
+        void append(const data_type &cu) {
+            if (cu.empty()) {
+                return;
+            }
+
+            assert(empty() || m_cus.back().min() <= cu.min());
+            index_gaps(cu, false);
+
+            if (!empty() && cu.min() <= m_cus.back().max()) {
+                auto &last = m_cus.back();
+                auto old_size = last.size();
+                last = data_type(last.min(), std::max(last.max(), cu.max()));
+                changed(last.size() - old_size);
+            } else {
+                m_cus.push_back(cu);
+                changed(cu.size());
+            }
+
+            index_gaps(cu, true);
+            summarize(cu, true);
+        }
+
+        // Appends the sorted, disjoint units [first, last) in bulk.
+        template<typename It>
+        void append(It first, It last) {
+            if (first == last) {
+                return;
+            }
+
+            auto from = first->min();
+            append(*first);
+            auto appended = m_cus.insert(m_cus.end(), ++first, last);
+            changed(accumulate(appended, m_cus.end(), T{}, [](T sum, const data_type &cu) { return sum + cu.size(); }));
+            index_gaps(data_type(from, m_cus.back().max()), true);
+            for (; appended != m_cus.end(); ++appended) {
+                summarize(*appended, true);
+            }
+        }
+
+        // Removes cu, which may span any number of intervals and gaps,
+        // trimming the intervals at its ends, in O(log n + k).
+        void erase(const data_type &cu) {
+            if (cu.empty()) {
+                return;
+            }
+
+            auto first = m_finger ? lower_bound_from(finger(), cu.min()) : lower_bound(cu);
+            erase_run(first, upper_bound_from(first, cu.max()), cu);
+        }
+
+        // Removes a single value with one lookup.
+        void erase(const value_type &value) {
+            if (auto i = find(value); i != end()) {
+                erase_run(i, next(i), data_type(value, value + 1));
+            }
+        }
+
+        void erase(const typename adapted_type::const_iterator &it) {
+            // copy first: the unit is overwritten as it is erased
+            erase_run(it, next(it), data_type(*it));
+        }
+
+        // Removes the ascending values.  They are coalesced into runs first
+        // and the runs removed in one merge pass: O(n + m) where
+        // erasing the values one at a time splits an interval per value.
+        void erase_values(span<const value_type> values) {
+            auto runs = runs_of(values);
+            if (empty() || runs.empty()) {
+                return;
+            }
+
+            adopt(difference(*this, runs));
+        }
+
+        // Parallel version for huge batches: the runs are removed by key
+        // partitions, as in the parallel difference().
+        void erase_values(span<const value_type> values, launch policy,
+                          size_t threads = thread::hardware_concurrency()) {
+            auto runs = runs_of(values);
+            if (empty() || runs.empty()) {
+                return;
+            }
+
+            adopt(difference(*this, runs, policy, threads));
+        }
+
+        // Removes the intervals satisfying pred in one pass and returns how
+        // many there were.
+        template<typename P>
+        size_t erase_if(P pred) {
+            T removed{};
+            auto dead = ranges::remove_if(m_cus, [&](const data_type &cu) {
+                if (!pred(cu)) {
+                    return false;
+                }
+                removed += cu.size();
+                return true;
+            });
+
+            auto count = dead.size();
+            m_cus.erase(dead.begin(), dead.end());
+            changed(-removed);
+            reindex();
+            return count;
+        }
+
+        // ============================= LOOKUP =============================
+
+        auto find(const data_type &cu) const {
+            if (m_summary && !cu.empty() && !m_summary->test(cu.min())) {
+                return end();
+            }
+            auto i = ranges::upper_bound(m_cus, cu, data_type_cmp());
+            return i != begin() && (--i)->includes(cu) ? i : end();
+        }
+
+        auto find(const value_type &value) const {
+            if (m_summary && !m_summary->test(value)) {
+                return end();
+            }
+            return m_finger ? find(finger(), value) : find(data_type(value, value + 1));
+        }
+
+        // Looks up value with the search starting from hint, in O(log d)
+        // for a result d intervals away.
+        auto find(const_iterator hint, const value_type &value) const {
+            auto i = lower_bound_from(hint, value);
+            remember(i);
+            return i != end() && i->min() <= value ? i : end();
+        }
+
+        // Makes find(value), insert and erase start from the position the
+        // previous call touched, which pays off when consecutive calls land
+        // close together.  The const find(value) moves that position too,
+        // through a relaxed atomic, so const lookups from several threads
+        // stay safe; they only make each other's starting points worse.
+        void enable_finger() {
+            m_finger = true;
+        }
+
+        void disable_finger() {
+            m_finger = false;
+        }
+
+        // Keeps one bit per block of 2^shift values telling whether any of
+        // them is covered, so that find and contains answer most misses with
+        // a single bit test.  Costs a bit per block between the lowest and
+        // the highest covered value, and a few word writes per modification.
+        void enable_summary(unsigned shift) {
+            m_summary.emplace(shift);
+            for (const auto &cu: *this) {
+                summarize(cu, true);
+            }
+        }
+
+        void disable_summary() {
+            m_summary.reset();
+        }
+
+        bool contains(const data_type &cu) const {
+            return find(cu) != end();
+        }
+
+        bool contains(const value_type &value) const {
+            return find(value) != end();
+        }
+
+        // Looks up the ascending values with one merge walk over the
+        // intervals, galloping when there are far fewer values than
+        // intervals; result[q] is find(values[q]).
+        void find_batch(span<const value_type> values, span<const_iterator> result) const {
+            navigate(values, result, [this](auto i, const value_type &x) {
+                return i != end() && i->min() <= x ? i : end();
+            });
+        }
+
+        // As above, but sets bit q % 64 of found[q / 64] when values[q] is
+        // covered and clears it otherwise.
+        void find_batch(span<const value_type> values, span<uint64_t> found) const {
+            assert(found.size() * 64 >= values.size());
+            assert(ranges::is_sorted(values));
+
+            ranges::fill(found, 0);
+            bool gallop = cunits_detail::skewed(values.size(), size());
+            auto i = begin();
+
+            for (size_t q = 0; q < values.size(); ++q) {
+                i = cunits_detail::seek_past(*this, i, values[q], gallop);
+                if (i != end() && i->min() <= values[q]) {
+                    found[q / 64] |= uint64_t{1} << (q % 64);
+                }
+            }
+        }
+
+        // Looks up values in any order, lookup_lanes of them at a time;
+        // result[q] is find(values[q]).
+        void find_many(span<const value_type> values, span<const_iterator> result) const {
+            assert(values.size() == result.size());
+
+            constexpr size_t lanes = cunits_detail::lookup_lanes;
+            size_t pos[lanes];
+
+            if (empty()) {
+                ranges::fill(result, end());
+                return;
+            }
+
+            for (size_t q0 = 0; q0 < values.size(); q0 += lanes) {
+                auto x = values.subspan(q0, std::min(lanes, values.size() - q0));
+                lower_bounds(x, pos);
+
+                for (size_t g = 0; g < x.size(); ++g) {
+                    auto i = begin() + pos[g];
+                    result[q0 + g] = i != end() && i->min() <= x[g] ? i : end();
+                }
+            }
+        }
+
+        // Sets bit q % 64 of found[q / 64] when values[q] is covered and
+        // clears it otherwise.  Ascending values take the merge walk of
+        // find_batch; others are searched as in find_many, and for
+        // cunits<int> the candidates of each group are gathered and tested
+        // in vector registers.
+        void contains_many(span<const value_type> values, span<uint64_t> found) const {
+            if (ranges::is_sorted(values)) {
+                find_batch(values, found);
+                return;
+            }
+
+            assert(found.size() * 64 >= values.size());
+            ranges::fill(found, 0);
+
+            constexpr size_t lanes = cunits_detail::lookup_lanes;
+            static_assert(64 % lanes == 0);
+            size_t pos[lanes];
+
+            if (empty()) {
+                return;
+            }
+
+            for (size_t q0 = 0; q0 < values.size(); q0 += lanes) {
+                auto x = values.subspan(q0, std::min(lanes, values.size() - q0));
+                lower_bounds(x, pos);
+
+#ifdef SPEC_VEC_SIMD
+                if constexpr (is_same_v<T, int>) {
+                    int candidate[lanes];
+                    uint16_t bits;
+                    if (x.size() == lanes && size() <= numeric_limits<int>::max() / 2) {
+                        for (size_t g = 0; g < lanes; ++g) {
+                            candidate[g] = static_cast<int>(std::min(pos[g], size() - 1));
+                        }
+                        if (cunits_detail::simd::contains(m_cus.data(), candidate, x.data(), bits)) {
+                            found[q0 / 64] |= uint64_t{bits} << q0 % 64;
+                            continue;
+                        }
+                    }
+                }
+#endif
+
+                uint64_t bits = 0;
+                for (size_t g = 0; g < x.size(); ++g) {
+                    bits |= uint64_t{pos[g] != size() && m_cus[pos[g]].min() <= x[g]} << g;
+                }
+                found[q0 / 64] |= bits << q0 % 64;
+            }
+        }
+
+        auto lower_bound(const data_type &cu) const {
+            return ranges::lower_bound(m_cus, cu, data_type_cmp());
+        }
+
+        auto upper_bound(const data_type &cu) const {
+            return ranges::upper_bound(m_cus, cu, data_type_cmp());
+        }
+
+        // The intervals sharing at least one unit with cu, in O(log n).
+        auto overlapping(const data_type &cu) const {
+            auto last = upper_bound(cu);
+            return ranges::subrange(cu.empty() ? last : lower_bound(cu), last);
+        }
+
+        // The overlapping intervals trimmed to cu, as a view over the set.
+        auto clipped(const data_type &cu) const {
+            return overlapping(cu) | views::transform([cu](const data_type &x) {
+                return data_type(std::max(x.min(), cu.min()), std::min(x.max(), cu.max()));
+            });
+        }
+
+        // Number of covered values below value, in O(log n).
+        T rank(const value_type &value) const {
+            return measure_below(value);
+        }
+
+        // The k-th covered value, counting from 0, in O(log n); k must be
+        // below cardinality().
+        value_type select(const T &k) const {
+            assert(k < cardinality());
+            const auto &sums = prefix();
+            auto i = ranges::upper_bound(sums, k) - sums.begin() - 1;
+            return m_cus[i].min() + (k - sums[i]);
+        }
+
+        // Ranks the ascending values into result with one merge walk,
+        // or one search per value when there are far fewer values than
+        // intervals.
+        void rank(span<const value_type> values, span<T> result) const {
+            assert(values.size() == result.size());
+            assert(ranges::is_sorted(values));
+
+            if (cunits_detail::skewed(values.size(), size())) {
+                ranges::transform(values, result.begin(), [this](const value_type &v) { return rank(v); });
+                return;
+            }
+
+            auto i = begin();
+            T below{};
+
+            for (size_t q = 0; q < values.size(); ++q) {
+                const auto &v = values[q];
+                for (; i != end() && i->max() <= v; ++i) {
+                    below += i->size();
+                }
+                result[q] = i != end() && i->min() < v ? below + (v - i->min()) : below;
+            }
+        }
+
+        // Selects the ascending ranks ks into result, walking or searching
+        // like the batched rank().
+        void select(span<const T> ks, span<value_type> result) const {
+            assert(ks.size() == result.size());
+            assert(ranges::is_sorted(ks));
+
+            if (cunits_detail::skewed(ks.size(), size())) {
+                ranges::transform(ks, result.begin(), [this](const T &k) { return select(k); });
+                return;
+            }
+
+            auto i = begin();
+            T before{};
+
+            for (size_t q = 0; q < ks.size(); ++q) {
+                assert(ks[q] < cardinality());
+                for (; before + i->size() <= ks[q]; ++i) {
+                    before += i->size();
+                }
+                result[q] = i->min() + (ks[q] - before);
+            }
+        }
+
+        // ============================= NAVIGATION =============================
+
+        // Smallest covered value at or after x.
+        optional<value_type> next_covered(const value_type &x) const {
+            return next_covered_from(lower_bound(data_type(x, x)), x);
+        }
+
+        // Largest covered value at or before x.
+        optional<value_type> prev_covered(const value_type &x) const {
+            return prev_covered_from(lower_bound(data_type(x, x)), x);
+        }
+
+        // The free run at or after x, clipped to start no earlier than x;
+        // past the last interval it extends to numeric_limits<T>::max().
+        data_type next_gap(const value_type &x) const {
+            return next_gap_from(lower_bound(data_type(x, x)), x);
+        }
+
+        // End of the interval covering x, if any.
+        optional<value_type> run_end(const value_type &x) const {
+            return run_end_from(lower_bound(data_type(x, x)), x);
+        }
+
+        // Batched forms of the above for ascending queries.
+
+        void next_covered(span<const value_type> xs, span<optional<value_type>> result) const {
+            navigate(xs, result, [this](auto i, const value_type &x) { return next_covered_from(i, x); });
+        }
+
+        void prev_covered(span<const value_type> xs, span<optional<value_type>> result) const {
+            navigate(xs, result, [this](auto i, const value_type &x) { return prev_covered_from(i, x); });
+        }
+
+        void next_gap(span<const value_type> xs, span<data_type> result) const {
+            navigate(xs, result, [this](auto i, const value_type &x) { return next_gap_from(i, x); });
+        }
+
+        void run_end(span<const value_type> xs, span<optional<value_type>> result) const {
+            navigate(xs, result, [this](auto i, const value_type &x) { return run_end_from(i, x); });
+        }
+
+        // ============================= GAPS =============================
+
+        // Lowest k contiguous free units inside universe (first fit).
+        optional<data_type> find_first_gap(const T &k, const data_type &universe) const {
+            assert(k > 0);
+
+            auto from = universe.min();
+            auto a = lower_bound(data_type(from, from));
+
+            if (a == end() || from < a->min()) {
+                auto to = a == end() ? universe.max() : std::min(a->min(), universe.max());
+                if (to - from >= k) {
+                    return data_type(from, from + k);
+                }
+                if (a == end()) {
+                    return nullopt;
+                }
+            }
+
+            // gaps only start later from here on, so the first wide enough
+            // one decides
+            auto x = gap_after(a, k);
+            auto start = x == end() ? prev(end())->max() : x->max();
+            if (start + k <= universe.max()) {
+                return data_type(start, start + k);
+            }
+
+            return nullopt;
+        }
+
+        // First fit among the free units of universe at or after from.
+        optional<data_type> find_first_gap(const T &k, const data_type &universe, const value_type &from) const {
+            auto start = std::clamp(from, universe.min(), universe.max());
+            return find_first_gap(k, data_type(start, universe.max()));
+        }
+
+        // Highest k contiguous free units inside universe (last fit).
+        optional<data_type> find_last_gap(const T &k, const data_type &universe) const {
+            assert(k > 0);
+
+            auto to = universe.max();
+            auto b = upper_bound(data_type(to, to));
+
+            if (b == begin() || prev(b)->max() < to) {
+                auto from = b == begin() ? universe.min() : std::max(prev(b)->max(), universe.min());
+                if (to - from >= k) {
+                    return data_type(to - k, to);
+                }
+                if (b == begin()) {
+                    return nullopt;
+                }
+            }
+
+            auto y = gap_before(prev(b), k);
+            auto stop = y == end() ? begin()->min() : y->min();
+            if (universe.min() + k <= stop) {
+                return data_type(stop - k, stop);
+            }
+
+            return nullopt;
+        }
+
+        // Indexes the gaps between intervals by size, making the best- and
+        // worst-fit queries O(log n) at the cost of O(log n) per touched
+        // gap in every modifier.
+        void enable_gap_index() {
+            m_gap_index.emplace();
+            if (!empty()) {
+                index_gaps(data_type(begin()->min(), prev(end())->max()), true);
+            }
+        }
+
+        void disable_gap_index() {
+            m_gap_index.reset();
+        }
+
+        // Smallest gap between two intervals with room for k units; the
+        // lowest one wins a tie.
+        optional<data_type> find_best_fit(const T &k) const {
+            assert(k > 0);
+
+            if (m_gap_index) {
+                auto g = m_gap_index->lower_bound({k, numeric_limits<T>::lowest()});
+                if (g == m_gap_index->end()) {
+                    return nullopt;
+                }
+                return data_type(g->second, g->second + g->first);
+            }
+
+            optional<data_type> best;
+            for (auto x = begin(), y = x; y != end() && ++y != end(); x = y) {
+                if (y->min() - x->max() >= k && (!best || y->min() - x->max() < best->size())) {
+                    best = data_type(x->max(), y->min());
+                }
+            }
+            return best;
+        }
+
+        // Largest gap between two intervals; the lowest one wins a tie.
+        optional<data_type> find_worst_fit() const {
+            if (m_gap_index) {
+                if (m_gap_index->empty()) {
+                    return nullopt;
+                }
+                auto g = m_gap_index->lower_bound({prev(m_gap_index->end())->first, numeric_limits<T>::lowest()});
+                return data_type(g->second, g->second + g->first);
+            }
+
+            optional<data_type> worst;
+            for (auto x = begin(), y = x; y != end() && ++y != end(); x = y) {
+                if (!worst || y->min() - x->max() > worst->size()) {
+                    worst = data_type(x->max(), y->min());
+                }
+            }
+            return worst;
+        }
+
+        // The k largest intervals, largest first and the lowest first among
+        // equals, in one pass that keeps the best k in a heap: O(n log k),
+        // without copying or sorting the set.
+        vector<data_type> largest_intervals(size_t k) const {
+            cunits_detail::top_k<T> best(k);
+            for (const auto &cu: *this) {
+                best.offer(cu);
+            }
+            return std::move(best).take();
+        }
+
+        // The k largest uncovered runs within universe, ordered like
+        // largest_intervals().  With the gap index the gaps are visited from
+        // the largest down until no smaller one can qualify; otherwise the
+        // intervals overlapping universe are walked once.
+        vector<data_type> largest_gaps(size_t k, const data_type &universe) const {
+            cunits_detail::top_k<T> best(k);
+
+            if (!k || universe.empty()) {
+                return {};
+            }
+
+            if (!m_gap_index) {
+                auto from = universe.min();
+                for (const auto &cu: overlapping(universe)) {
+                    if (from < cu.min()) {
+                        best.offer(data_type(from, cu.min()));
+                    }
+                    from = cu.max();
+                }
+                if (from < universe.max()) {
+                    best.offer(data_type(from, universe.max()));
+                }
+                return std::move(best).take();
+            }
+
+            // the runs before the first and after the last interval are not
+            // indexed
+            auto first = empty() ? universe.max() : begin()->min();
+            auto last = empty() ? universe.min() : prev(end())->max();
+            if (universe.min() < first) {
+                best.offer(data_type(universe.min(), std::min(first, universe.max())));
+            }
+            if (last < universe.max() && !empty()) {
+                best.offer(data_type(std::max(last, universe.min()), universe.max()));
+            }
+
+            for (auto g = m_gap_index->rbegin(); g != m_gap_index->rend(); ++g) {
+                if (best.full() && g->first < best.worst()) {
+                    break;
+                }
+
+                auto min = std::max(g->second, universe.min());
+                auto max = std::min(g->second + g->first, universe.max());
+                if (min < max) {
+                    best.offer(data_type(min, max));
+                }
+            }
+
+            return std::move(best).take();
+        }
+
+        // ============================= SAMPLING =============================
+
+        // A uniformly random covered value, in O(log n); the set must not be
+        // empty.
+        template<typename R>
+        value_type sample_value(R &rng) const {
+            assert(!empty());
+            return select(cunits_detail::draw(rng, cardinality()));
+        }
+
+        // Fills out with uniformly random covered values, in ascending
+        // order: the ranks are drawn and sorted first, so one walk selects
+        // them all.
+        template<typename R>
+        void sample_values(R &rng, span<value_type> out) const {
+            assert(!empty() || out.empty());
+
+            vector<T> ks(out.size());
+            for (auto &k: ks) {
+                k = cunits_detail::draw(rng, cardinality());
+            }
+            ranges::sort(ks);
+            select(ks, out);
+        }
+
+        // A gap between two intervals of at least min_size units, drawn with
+        // probability proportional to its size, or nullopt if there is none.
+        // Each draw picks a uniformly random uncovered unit in O(log n) and
+        // keeps its gap if it is large enough; after sample_attempts misses
+        // the large enough gaps are listed and one is drawn from them.
+        template<typename R>
+        optional<data_type> sample_gap(R &rng, const T &min_size) const {
+            assert(min_size > 0);
+
+            if (empty() || gap_after(begin(), min_size) == end()) {
+                return nullopt;
+            }
+
+            auto uncovered = prev(end())->max() - begin()->min() - cardinality();
+            for (int attempt = 0; attempt < cunits_detail::sample_attempts; ++attempt) {
+                auto y = gap_select(cunits_detail::draw(rng, uncovered));
+                data_type gap(prev(y)->max(), y->min());
+                if (gap.size() >= min_size) {
+                    return gap;
+                }
+            }
+
+            vector<data_type> candidates;
+            T total{};
+            for (auto x = gap_after(begin(), min_size); x != end(); x = gap_after(next(x), min_size)) {
+                candidates.emplace_back(x->max(), next(x)->min());
+                total += candidates.back().size();
+            }
+
+            auto k = cunits_detail::draw(rng, total);
+            for (const auto &gap: candidates) {
+                if (k < gap.size()) {
+                    return gap;
+                }
+                k -= gap.size();
+            }
+            return candidates.back();
+        }
+
+        // ============================= CONVERSIONS =============================
+
+        static set<data_type> from_vector(const vector<value_type> &values) {
+            set<data_type> result;
+            auto first = values.begin();
+            auto last = values.end();
+            while (first != last) {
+                auto min_value = *first;
+                auto max_value = min_value;
+                while (++first != last && *first == max_value + 1) {
+                    max_value = *first;
+                }
+                result.insert(cunits(min_value, max_value + 1));
+            }
+            return result;
+        }
+
+        static set<data_type> from_set_of(const set<value_type> &values) {
+            auto vec = vector<value_type>(values.begin(), values.end());
+            auto result = from_vector(vec);
+            return result;
+        }
+
+        vector<value_type> to_vector() const {
+            vector<value_type> result;
+            for (const auto &cu: m_cus) {
+                for (auto value = cu.min(); value < cu.max(); ++value) {
+                    result.push_back(value);
+                }
+            }
+            return result;
+        }
+
+        set<value_type> to_set_of() const {
+            auto vec = to_vector();
+            set<value_type> result(vec.begin(), vec.end());
+            return result;
+        }
+
+    };
+
+    // ============================= NON-MEMBER FUNCTIONS =============================
+
+    // Removes the intervals satisfying pred, like erase_if on other sets.
+    template<typename T, typename P>
+    size_t erase_if(set<cunits<T>> &cus, P pred) {
+        return cus.erase_if(pred);
+    }
+
+    template<typename T>
+    bool operator==(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs) {
+        return ranges::equal(lhs, rhs);
+    }
+
+    template<typename T>
+    bool operator!=(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs) {
+        return !(lhs == rhs);
+    }
+
+    template<typename T>
+    ostream &operator<<(ostream &os, const set<cunits<T>> &cus) {
+        os << "{";
+        for (auto it = cus.begin(); it != cus.end(); ++it) {
+            os << *it;
+            if (next(it) != cus.end()) {
+                os << ", ";
+            }
+        }
+        os << "}";
+        return os;
+    }
+
+    template<typename T>
+    istream &operator>>(istream &is, set<cunits<T>> &cus) {
+        char c;
+
+        is >> c;
+        assert(!is.fail() && c == '{');
+
+        for (cunits<T> cu; is >> cu;) {
+            cus.insert(cu);
+            is >> c;
+            if (c == '}') {
+                break;
+            }
+        }
+
+        return is;
+    }
+
+    namespace cunits_detail {
+#ifdef SPEC_VEC_SIMD
+        // Vectorized intersection kernels for sets of cunits<int>, picked at
+        // run time by the instruction sets the CPU supports.
+        namespace simd {
+            using unit = cunits<int>;
+
+            static_assert(sizeof(unit) == 2 * sizeof(int) && is_standard_layout_v<unit>);
+
+            // Below this many units per input the scalar merge is cheaper.
+            inline constexpr size_t threshold = 32;
+
+            // 0 for none, 1 for AVX2, 2 for AVX-512.
+            inline int level() {
+                static const int level = [] {
+                    __builtin_cpu_init();
+                    return __builtin_cpu_supports("avx512f") ? 2 : __builtin_cpu_supports("avx2") ? 1 : 0;
+                }();
+                return level;
+            }
+
+            // A pair of blocks of four units overlaps in at most seven pairs.
+            inline constexpr ptrdiff_t block_output = 7;
+
+            // Intersects the inputs four units at a time: all 16 pairs of
+            // the current blocks are tested for overlap at once, the
+            // overlaps are compacted to out in order, and the block with the
+            // lower upper endpoint is replaced.  Stops when either input has
+            // fewer than four units left or out is nearly full.
+            __attribute__((target("avx512f")))
+            inline unit *intersect_avx512(const unit *&a, const unit *a_last, const unit *&b, const unit *b_last,
+                                          unit *out, const unit *out_last) {
+                const __m512i a_min_idx = _mm512_setr_epi32(0, 0, 0, 0, 2, 2, 2, 2, 4, 4, 4, 4, 6, 6, 6, 6);
+                const __m512i a_max_idx = _mm512_add_epi32(a_min_idx, _mm512_set1_epi32(1));
+                const __m512i b_min_idx = _mm512_setr_epi32(8, 10, 12, 14, 8, 10, 12, 14, 8, 10, 12, 14, 8, 10, 12, 14);
+                const __m512i b_max_idx = _mm512_add_epi32(b_min_idx, _mm512_set1_epi32(1));
+                alignas(64) int lo[16];
+                alignas(64) int hi[16];
+
+                while (a_last - a >= 4 && b_last - b >= 4 && out_last - out >= block_output) {
+                    auto blocks = _mm512_inserti64x4(
+                            _mm512_zextsi256_si512(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a))),
+                            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b)), 1);
+                    auto a_min = _mm512_permutexvar_epi32(a_min_idx, blocks);
+                    auto a_max = _mm512_permutexvar_epi32(a_max_idx, blocks);
+                    auto b_min = _mm512_permutexvar_epi32(b_min_idx, blocks);
+                    auto b_max = _mm512_permutexvar_epi32(b_max_idx, blocks);
+
+                    __mmask16 overlap = _mm512_cmpgt_epi32_mask(a_max, b_min) & _mm512_cmpgt_epi32_mask(b_max, a_min);
+                    if (overlap) {
+                        _mm512_mask_compressstoreu_epi32(lo, overlap, _mm512_max_epi32(a_min, b_min));
+                        _mm512_mask_compressstoreu_epi32(hi, overlap, _mm512_min_epi32(a_max, b_max));
+                        for (int k = 0, n = __builtin_popcount(overlap); k < n; ++k) {
+                            *out++ = unit(lo[k], hi[k]);
+                        }
+                    }
+
+                    auto a_top = a[3].max();
+                    auto b_top = b[3].max();
+                    a += 4 * (a_top <= b_top);
+                    b += 4 * (b_top <= a_top);
+                }
+
+                return out;
+            }
+
+            __attribute__((target("avx2")))
+            inline unit *intersect_avx2(const unit *&a, const unit *a_last, const unit *&b, const unit *b_last,
+                                        unit *out, const unit *out_last) {
+                const __m256i a_min_idx[2] = {_mm256_setr_epi32(0, 0, 0, 0, 2, 2, 2, 2),
+                                              _mm256_setr_epi32(4, 4, 4, 4, 6, 6, 6, 6)};
+                const __m256i b_min_idx = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+                const __m256i one = _mm256_set1_epi32(1);
+                alignas(32) int lo[8];
+                alignas(32) int hi[8];
+
+                while (a_last - a >= 4 && b_last - b >= 4 && out_last - out >= block_output) {
+                    auto va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a));
+                    auto vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b));
+                    auto b_min = _mm256_permutevar8x32_epi32(vb, b_min_idx);
+                    auto b_max = _mm256_permutevar8x32_epi32(vb, _mm256_add_epi32(b_min_idx, one));
+
+                    // two rows of the 4x4 pair matrix per vector
+                    for (const auto &idx: a_min_idx) {
+                        auto a_min = _mm256_permutevar8x32_epi32(va, idx);
+                        auto a_max = _mm256_permutevar8x32_epi32(va, _mm256_add_epi32(idx, one));
+                        auto overlap = _mm256_and_si256(_mm256_cmpgt_epi32(a_max, b_min), _mm256_cmpgt_epi32(b_max, a_min));
+
+                        if (unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(overlap))) {
+                            _mm256_store_si256(reinterpret_cast<__m256i *>(lo), _mm256_max_epi32(a_min, b_min));
+                            _mm256_store_si256(reinterpret_cast<__m256i *>(hi), _mm256_min_epi32(a_max, b_max));
+                            for (; mask; mask &= mask - 1) {
+                                auto k = __builtin_ctz(mask);
+                                *out++ = unit(lo[k], hi[k]);
+                            }
+                        }
+                    }
+
+                    auto a_top = a[3].max();
+                    auto b_top = b[3].max();
+                    a += 4 * (a_top <= b_top);
+                    b += 4 * (b_top <= a_top);
+                }
+
+                return out;
+            }
+
+            template<typename R>
+            inline constexpr bool supported = contiguous_iterator<decltype(declval<const R &>().begin())>
+                                              && is_same_v<remove_cvref_t<decltype(*declval<const R &>().begin())>, unit>;
+
+            template<typename L, typename R, typename Out>
+            bool intersect(const L &lhs, const R &rhs, Out &out) {
+                auto isa = level();
+                if (!isa || lhs.size() < threshold || rhs.size() < threshold) {
+                    return false;
+                }
+
+                const unit *a = to_address(lhs.begin());
+                const unit *a_last = to_address(lhs.end());
+                const unit *b = to_address(rhs.begin());
+                const unit *b_last = to_address(rhs.end());
+
+                // the output is flushed from a small buffer in bulk
+                array<unit, 256> buffer;
+
+                while (a_last - a >= 4 && b_last - b >= 4) {
+                    auto first = buffer.data();
+                    auto last = isa == 2 ? intersect_avx512(a, a_last, b, b_last, first, first + buffer.size())
+                                         : intersect_avx2(a, a_last, b, b_last, first, first + buffer.size());
+                    out.append(first, last);
+                }
+
+                // finish the last partial blocks with the scalar merge
+                while (a != a_last && b != b_last) {
+                    if (a->max() <= b->min()) {
+                        ++a;
+                    } else if (b->max() <= a->min()) {
+                        ++b;
+                    } else {
+                        out.append(unit(std::max(a->min(), b->min()), std::min(a->max(), b->max())));
+                        if (a->max() < b->max()) {
+                            ++a;
+                        } else {
+                            ++b;
+                        }
+                    }
+                }
+
+                return true;
+            }
+
+            // Tests the 16 values x[g] against their candidate units
+            // data[pos[g]], gathering both endpoints into vector registers;
+            // bit g of the result is set when the unit contains x[g].
+            __attribute__((target("avx512f")))
+            inline uint16_t contains_avx512(const unit *data, const int *pos, const int *x) {
+                auto ends = reinterpret_cast<const int *>(data);
+                auto i = _mm512_slli_epi32(_mm512_loadu_si512(pos), 1);
+                auto lo = _mm512_i32gather_epi32(i, ends, 4);
+                auto hi = _mm512_i32gather_epi32(i, ends + 1, 4);
+                auto v = _mm512_loadu_si512(x);
+                return _mm512_cmple_epi32_mask(lo, v) & _mm512_cmplt_epi32_mask(v, hi);
+            }
+
+            __attribute__((target("avx2")))
+            inline uint16_t contains_avx2(const unit *data, const int *pos, const int *x) {
+                auto ends = reinterpret_cast<const int *>(data);
+                unsigned mask = 0;
+
+                for (int h = 0; h < 16; h += 8) {
+                    auto i = _mm256_slli_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(pos + h)), 1);
+                    auto lo = _mm256_i32gather_epi32(ends, i, 4);
+                    auto hi = _mm256_i32gather_epi32(ends + 1, i, 4);
+                    auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(x + h));
+                    auto in = _mm256_andnot_si256(_mm256_cmpgt_epi32(lo, v), _mm256_cmpgt_epi32(hi, v));
+                    mask |= unsigned(_mm256_movemask_ps(_mm256_castsi256_ps(in))) << h;
+                }
+
+                return mask;
+            }
+
+            static_assert(lookup_lanes == 16);
+
+            // False when the CPU has neither kernel.
+            inline bool contains(const unit *data, const int *pos, const int *x, uint16_t &mask) {
+                auto isa = level();
+                if (!isa) {
+                    return false;
+                }
+
+                mask = isa == 2 ? contains_avx512(data, pos, x) : contains_avx2(data, pos, x);
+                return true;
+            }
+        }
+#endif
+
+        // The set algebra kernels read two sorted ranges of disjoint units
+        // (sets, or key_ranges of them) and append the result to out.
+
+        template<typename L, typename R, typename Out>
+        void intersect_into(const L &lhs, const R &rhs, Out &out) {
+            // gallop through the larger range when the sizes are skewed
+            if (skewed(rhs.size(), lhs.size())) {
+                intersect_into(rhs, lhs, out);
+                return;
+            }
+
+            if (skewed(lhs.size(), rhs.size())) {
+                auto j = rhs.begin();
+
+                for (const auto &cu: lhs) {
+                    j = seek_past(rhs, j, cu.min(), true);
+                    for (auto k = j; k != rhs.end() && k->min() < cu.max(); ++k) {
+                        out.append({std::max(cu.min(), k->min()), std::min(cu.max(), k->max())});
+                    }
+                }
+
+                return;
+            }
+
+#ifdef SPEC_VEC_SIMD
+            if constexpr (simd::supported<L> && simd::supported<R>) {
+                if (simd::intersect(lhs, rhs, out)) {
+                    return;
+                }
+            }
+#endif
+
+            auto i = lhs.begin();
+            auto j = rhs.begin();
+
+            while (i != lhs.end() && j != rhs.end()) {
+                if (i->max() <= j->min()) {
+                    ++i;
+                    continue;
+                }
+
+                if (j->max() <= i->min()) {
+                    ++j;
+                    continue;
+                }
+
+                auto min = std::max(i->min(), j->min());
+                auto max = std::min(i->max(), j->max());
+                out.append({min, max});
+
+                if (i->max() < j->max()) {
+                    ++i;
+                } else {
+                    ++j;
+                }
+            }
+        }
+
+        template<typename L, typename R, typename Out>
+        void union_into(const L &lhs, const R &rhs, Out &out) {
+            if (lhs.size() > rhs.size()) {
+                union_into(rhs, lhs, out);
+                return;
+            }
+
+            // copy the runs of the larger range that fall between the units
+            // of the smaller one in bulk
+            if (skewed(lhs.size(), rhs.size())) {
+                auto j = rhs.begin();
+
+                for (const auto &cu: lhs) {
+                    auto k = seek_past(rhs, j, cu.min(), true);
+                    out.append(j, k);
+                    j = k;
+
+                    while (j != rhs.end() && j->min() <= cu.min()) {
+                        out.append(*j++);
+                    }
+                    out.append(cu);
+                    while (j != rhs.end() && j->min() <= cu.max()) {
+                        out.append(*j++);
+                    }
+                }
+
+                out.append(j, rhs.end());
+                return;
+            }
+
+            if (rhs.size() == 0) {
+                return;
+            }
+
+            auto i = lhs.begin();
+            auto j = rhs.begin();
+
+            auto next = [&] {
+                return j == rhs.end() || (i != lhs.end() && i->min() < j->min()) ? *i++ : *j++;
+            };
+
+            // coalesce locally and append only finished units
+            auto cur = next();
+
+            while (i != lhs.end() || j != rhs.end()) {
+                auto cu = next();
+                if (cur.max() < cu.min()) {
+                    out.append(cur);
+                    cur = cu;
+                } else if (cur.max() < cu.max()) {
+                    cur = {cur.min(), cu.max()};
+                }
+            }
+
+            out.append(cur);
+        }
+
+        template<typename L, typename R, typename Out>
+        void difference_into(const L &lhs, const R &rhs, Out &out) {
+            // a small subtrahend: gallop through lhs, copying the untouched
+            // runs between the removed units in bulk
+            if (skewed(rhs.size(), lhs.size())) {
+                auto i = lhs.begin();
+                bool cut = false;
+                remove_cvref_t<decltype(i->min())> lo{};
+
+                for (const auto &cu: rhs) {
+                    if (i == lhs.end()) {
+                        break;
+                    }
+
+                    auto k = seek_past(lhs, i, cu.min(), true);
+                    if (k != i) {
+                        if (cut) {
+                            out.append({lo, i->max()});
+                            ++i;
+                            cut = false;
+                        }
+                        out.append(i, k);
+                        i = k;
+                    }
+
+                    while (i != lhs.end() && i->min() < cu.max()) {
+                        auto min = cut ? lo : i->min();
+                        if (min < cu.min()) {
+                            out.append({min, cu.min()});
+                        }
+
+                        if (cu.max() < i->max()) {
+                            cut = true;
+                            lo = cu.max();
+                            break;
+                        }
+
+                        ++i;
+                        cut = false;
+                    }
+                }
+
+                if (i != lhs.end() && cut) {
+                    out.append({lo, i->max()});
+                    ++i;
+                }
+                out.append(i, lhs.end());
+                return;
+            }
+
+            // otherwise walk lhs, galloping through rhs when it is the larger
+            bool gallop = skewed(lhs.size(), rhs.size());
+            auto j = rhs.begin();
+
+            for (const auto &cu: lhs) {
+                j = seek_past(rhs, j, cu.min(), gallop);
 
-        bool verify()
-        {
-            if (auto i = begin(); i != end())
-                for (auto p = i; ++i != end(); ++p)
-                    if (p->max() > i->min())
-                        return false;
+                auto min = cu.min();
+                for (auto k = j; k != rhs.end() && k->min() < cu.max(); ++k) {
+                    if (min < k->min()) {
+                        out.append({min, k->min()});
+                    }
+                    min = k->max();
+                }
 
-            return true;
+                if (min < cu.max()) {
+                    out.append({min, cu.max()});
+                }
+            }
         }
 
-    public:
-        // ============================= CONSTRUCTORS =============================
+        // The units of a set overlapping the keys [lo, hi), unclipped.
+        template<typename S>
+        class key_range {
+            using data_type = remove_cvref_t<decltype(*declval<S>().begin())>;
+            using value_type = remove_cvref_t<decltype(declval<data_type>().min())>;
+            using iterator = decltype(declval<const S &>().begin());
+
+            const S *m_set;
+            value_type m_hi;
+            iterator m_first;
+            iterator m_last;
+            size_t m_size;
+
+        public:
+            key_range(const S &s, const value_type &lo, const value_type &hi)
+                    : m_set(&s), m_hi(hi),
+                      m_first(s.lower_bound({lo, lo})),
+                      m_last(s.upper_bound({hi, hi})),
+                      m_size(distance(m_first, m_last)) {
+            }
 
-        set() = default;
+            iterator begin() const {
+                return m_first;
+            }
 
-        set(initializer_list<data_type> initializer_list) {
-            for (const auto &i: initializer_list) {
-                insert(i);
+            iterator end() const {
+                return m_last;
             }
-        }
 
-        // ============================= OPERATORS =============================
+            size_t size() const {
+                return m_size;
+            }
 
-        set &operator=(const set &) = default;
+            iterator lower_bound(const data_type &cu) const {
+                auto i = m_set->lower_bound(cu);
+                return i == m_set->end() || m_hi <= i->min() ? m_last : i;
+            }
+        };
 
-        bool operator < (const set<cunits<T>> &rhs) const {
-            return static_cast<adapted_type>(*this) < static_cast<adapted_type>(rhs);
-        }
+        // Appends to out only the parts of units within the keys [lo, hi).
+        template<typename Out, typename V>
+        class clip_appender {
+            Out &m_out;
+            V m_lo;
+            V m_hi;
 
-        bool operator()(const data_type &lhs, const data_type &rhs) const {
-            return lhs.max() <= rhs.min();
-        }
+        public:
+            clip_appender(Out &out, const V &lo, const V &hi) : m_out(out), m_lo(lo), m_hi(hi) {
+            }
 
-        bool operator == (const set<cunits<T>> &rhs) const {
-            if (size() != rhs.size()) {
-                return false;
+            void append(const cunits<V> &cu) {
+                auto min = std::max(cu.min(), m_lo);
+                auto max = std::min(cu.max(), m_hi);
+                if (min < max) {
+                    m_out.append({min, max});
+                }
             }
 
-            for(auto i = begin(), j = rhs.begin(); i != end(); ++i, ++j) {
-                if(*i != *j) {
-                    return false;
+            template<typename It>
+            void append(It first, It last) {
+                for (; first != last; ++first) {
+                    append(*first);
                 }
             }
+        };
 
-            return true;
-        }
+        // Partitions whose larger input holds fewer units than this are not
+        // worth a thread of their own.
+        inline constexpr size_t parallel_grain = 1 << 14;
+
+        // The output of one partition: units appended in order, merged with
+        // the previous one when they overlap or touch, and their total size.
+        // skip is 1 once the first unit has been merged into an earlier
+        // partition.
+        template<typename T>
+        struct partition_piece {
+            vector<cunits<T>> units;
+            T measure{};
+            size_t skip = 0;
+
+            void append(const cunits<T> &cu) {
+                if (cu.empty()) {
+                    return;
+                }
 
-        // ============================= ITERATORS =============================
+                measure += cu.size();
+                if (!units.empty() && cu.min() <= units.back().max()) {
+                    auto &last = units.back();
+                    measure -= std::min(last.max(), cu.max()) - cu.min();
+                    last = cunits<T>(last.min(), std::max(last.max(), cu.max()));
+                } else {
+                    units.push_back(cu);
+                }
+            }
 
-        auto begin() const {
-            return m_cus.begin();
-        }
+            template<typename It>
+            void append(It first, It last) {
+                for (; first != last; ++first) {
+                    append(*first);
+                }
+            }
+        };
 
-        auto end() const {
-            return m_cus.end();
+        // Runs task(p) for every partition p with the given launch policy
+        // and waits for all of them.
+        template<typename Task>
+        void for_each_partition(launch policy, size_t parts, Task task) {
+            vector<future<void>> done;
+            for (size_t p = 0; p < parts; ++p) {
+                done.push_back(async(policy, task, p));
+            }
+            for (auto &d: done) {
+                d.get();
+            }
         }
 
-        // ============================= CAPACITY =============================
+        // Merges the units that touch across the seams between consecutive
+        // pieces into the earlier piece, in O(parts).  The pieces were
+        // clipped to disjoint key ranges, so their measures still add up.
+        template<typename T>
+        void stitch(vector<partition_piece<T>> &pieces) {
+            cunits<T> *tail = nullptr;
 
-        [[nodiscard]] bool empty() const {
-            return m_cus.empty();
-        }
+            for (auto &piece: pieces) {
+                if (piece.units.empty()) {
+                    continue;
+                }
 
-        auto size() const {
-            return m_cus.size();
+                const auto &head = piece.units.front();
+                if (tail && head.min() <= tail->max()) {
+                    *tail = cunits<T>(tail->min(), std::max(tail->max(), head.max()));
+                    piece.skip = 1;
+                    if (piece.units.size() == 1) {
+                        continue;
+                    }
+                }
+                tail = &piece.units.back();
+            }
         }
 
-        bool includes(const data_type &cu) const {
-            auto i = ranges::upper_bound(m_cus, cu, data_type_cmp());
-            return i != begin() && (--i)->includes(cu);
-        }
+        // Splits the keys covered by lhs and rhs at boundaries sampled from
+        // the larger set into up to threads partitions and runs kernel on
+        // each with the given launch policy.  Once the pieces are sized and
+        // stitched at the seams, every partition copies its piece into the
+        // presized result at its own offset.
+        template<typename T, typename Kernel>
+        set<cunits<T>> partitioned(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs, launch policy,
+                                   size_t threads, Kernel kernel) {
+            const auto &large = lhs.size() < rhs.size() ? rhs : lhs;
+            size_t parts = std::min(threads, large.size() / parallel_grain);
+
+            if (parts < 2 || lhs.empty() || rhs.empty()) {
+                set<cunits<T>> ret;
+                kernel(lhs, rhs, ret);
+                return ret;
+            }
 
-        bool includes(const set<cunits<T>> &cus) const {
-            return ranges::all_of(cus, [this](const auto &cu) {
-                return this->includes(cu);
+            auto bounds = sample_bounds(large, parts);
+            bounds.front() = std::min(lhs.begin()->min(), rhs.begin()->min());
+            bounds.back() = std::max(prev(lhs.end())->max(), prev(rhs.end())->max());
+
+            vector<partition_piece<T>> pieces(parts);
+            for_each_partition(policy, parts, [&](size_t p) {
+                key_range l(lhs, bounds[p], bounds[p + 1]);
+                key_range r(rhs, bounds[p], bounds[p + 1]);
+                pieces[p].units.reserve(l.size() + r.size());
+                clip_appender out(pieces[p], bounds[p], bounds[p + 1]);
+                kernel(l, r, out);
             });
-        }
 
-        // ============================= MODIFIERS =============================
+            stitch(pieces);
 
-        void clear() {
-            m_cus.clear();
-        }
+            vector<size_t> offsets(parts + 1);
+            T cardinality{};
+            for (size_t p = 0; p < parts; ++p) {
+                offsets[p + 1] = offsets[p] + pieces[p].units.size() - pieces[p].skip;
+                cardinality += pieces[p].measure;
+            }
 
-        void insert(const data_type &new_cu) {
-            auto min = new_cu.min();
-            auto max = new_cu.max();
-            auto i = ranges::upper_bound(m_cus, new_cu, data_type_cmp());
-            auto j = i;
+            vector<cunits<T>> units(offsets.back());
+            for_each_partition(policy, parts, [&](size_t p) {
+                const auto &piece = pieces[p].units;
+                copy(piece.begin() + pieces[p].skip, piece.end(), units.begin() + offsets[p]);
+            });
 
-            // check if the new unit already exists
-            if (ranges::find(m_cus, new_cu) != end()) {
-                return;
-            }
+            return set<cunits<T>>(std::move(units), cardinality);
+        }
+    }
 
-            // look for overlapping intervals on the left
-            // and merge them
-            if (auto i2 = i; i2 != begin() && (--i2)->max() >= new_cu.min()) {
-                --i;
-                min = i->min();
-            }
+    template<typename T>
+    set<cunits<T>> intersection(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs) {
+        set<cunits<T>> ret;
+        cunits_detail::intersect_into(lhs, rhs, ret);
+        return ret;
+    }
 
-            // look for overlapping intervals on the right
-            // and merge them
-            if (j != end() && new_cu.max() >= j->min()) {
-                max = j->max();
-                ++j;
-            }
+    template<typename T>
+    set<cunits<T>> union_of(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs) {
+        set<cunits<T>> ret;
+        cunits_detail::union_into(lhs, rhs, ret);
+        return ret;
+    }
 
-            j = m_cus.erase(i, j);
-            data_type insert_cu(min, max);
-            auto pos = m_cus.insert(j, insert_cu);
+    template<typename T>
+    set<cunits<T>> difference(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs) {
+        set<cunits<T>> ret;
+        cunits_detail::difference_into(lhs, rhs, ret);
+        return ret;
+    }
 
-            assert(*pos == insert_cu);
-            assert(verify());
-        }
+    // Parallel versions for huge inputs: the key space is split into one
+    // partition per thread and the partitions are processed with the given
+    // launch policy.
 
-        void erase(const data_type &new_cu) {
-            // find the unit from which we erase
-            auto i = ranges::lower_bound(m_cus, new_cu, data_type_cmp());
+    template<typename T>
+    set<cunits<T>> intersection(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs, launch policy,
+                           size_t threads = thread::hardware_concurrency()) {
+        return cunits_detail::partitioned(lhs, rhs, policy, threads, [](const auto &l, const auto &r, auto &out) {
+            cunits_detail::intersect_into(l, r, out);
+        });
+    }
 
-            // check if the unit exists
-            assert(i != end());
+    template<typename T>
+    set<cunits<T>> union_of(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs, launch policy,
+                           size_t threads = thread::hardware_concurrency()) {
+        return cunits_detail::partitioned(lhs, rhs, policy, threads, [](const auto &l, const auto &r, auto &out) {
+            cunits_detail::union_into(l, r, out);
+        });
+    }
 
-            const auto erase_cu = *i;
-            assert(erase_cu.includes(new_cu));
+    template<typename T>
+    set<cunits<T>> difference(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs, launch policy,
+                           size_t threads = thread::hardware_concurrency()) {
+        return cunits_detail::partitioned(lhs, rhs, policy, threads, [](const auto &l, const auto &r, auto &out) {
+            cunits_detail::difference_into(l, r, out);
+        });
+    }
 
-            i = m_cus.erase(i);
+    template<typename T>
+    set<cunits<T>> intersection(const cunits<T> &lhs, const set<cunits<T>> &rhs) {
+        return intersection(set<cunits<T>>{lhs}, rhs);
+    }
 
-            // check if we need to split the unit
+    template<typename T>
+    set<cunits<T>> intersection(const set<cunits<T>> &lhs, const cunits<T> &rhs) {
+        return intersection(lhs, set<cunits<T>>{rhs});
+    }
 
-            // check if we need to add a new unit on the right
-            if (new_cu.max() < erase_cu.max()) {
-                i = m_cus.insert(i, data_type(new_cu.max(), erase_cu.max()));
-            }
+    template<typename T>
+    set<cunits<T>> intersection(const cunits<T> &lhs, const cunits<T> &rhs) {
+        return intersection(set<cunits<T>>{lhs}, set<cunits<T>>{rhs});
+    }
 
-            // check if we need to add a new unit on the left
-            if (erase_cu.min() < new_cu.min()) {
-                m_cus.insert(i, data_type(erase_cu.min(), new_cu.min()));
-            }
+    // ============================= MEASURES =============================
 
-            assert(verify());
-        }
+    // The measure of a set is the number of units it covers.  None of the
+    // functions below allocate; each walks the sets once, galloping
+    // through the larger one when their sizes are skewed.
 
-        void erase(const typename adapted_type::const_iterator &it) {
-            erase(*it);
+    template<typename T>
+    bool overlaps(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs) {
+        if (lhs.size() > rhs.size()) {
+            return overlaps(rhs, lhs);
         }
 
-        // ============================= LOOKUP =============================
+        bool gallop = cunits_detail::skewed(lhs.size(), rhs.size());
+        auto j = rhs.begin();
 
-        auto find(const data_type &cu) const {
-            auto i = ranges::upper_bound(m_cus, cu, data_type_cmp());
-            return i != begin() && (--i)->includes(cu) ? i : end();
+        for (const auto &cu: lhs) {
+            j = cunits_detail::seek_past(rhs, j, cu.min(), gallop);
+            if (j == rhs.end()) {
+                return false;
+            }
+            if (j->min() < cu.max()) {
+                return true;
+            }
         }
 
-        auto find(const value_type &value) const {
-            return find(data_type(value, value + 1));
-        }
+        return false;
+    }
 
-        bool contains(const data_type &cu) const {
-            return find(cu) != end();
+    template<typename T>
+    T intersection_measure(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs) {
+        if (lhs.size() > rhs.size()) {
+            return intersection_measure(rhs, lhs);
         }
 
-        bool contains(const value_type &value) const {
-            return find(value) != end();
-        }
+        bool gallop = cunits_detail::skewed(lhs.size(), rhs.size());
+        auto j = rhs.begin();
+        T result{};
 
-        auto lower_bound(const data_type &cu) const {
-            return ranges::lower_bound(m_cus, cu, data_type_cmp());
+        for (const auto &cu: lhs) {
+            j = cunits_detail::seek_past(rhs, j, cu.min(), gallop);
+            for (auto k = j; k != rhs.end() && k->min() < cu.max(); ++k) {
+                result += std::min(cu.max(), k->max()) - std::max(cu.min(), k->min());
+            }
         }
 
-        auto upper_bound(const data_type &cu) const {
-            return ranges::upper_bound(m_cus, cu, data_type_cmp());
-        }
+        return result;
+    }
 
-        // ============================= CONVERSIONS =============================
+    template<typename T>
+    T union_measure(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs) {
+        return lhs.cardinality() + rhs.cardinality() - intersection_measure(lhs, rhs);
+    }
 
-        static set<data_type> from_vector(const vector<value_type> &values) {
-            set<data_type> result;
-            auto first = values.begin();
-            auto last = values.end();
-            while (first != last) {
-                auto min_value = *first;
-                auto max_value = min_value;
-                while (++first != last && *first == max_value + 1) {
-                    max_value = *first;
-                }
-                result.insert(cunits(min_value, max_value + 1));
-            }
-            return result;
+    // |lhs & rhs| / |lhs | rhs|; two empty sets are identical, so 1.
+    template<typename T>
+    double jaccard(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs) {
+        auto common = intersection_measure(lhs, rhs);
+        auto united = lhs.cardinality() + rhs.cardinality() - common;
+        return united ? static_cast<double>(common) / static_cast<double>(united) : 1.0;
+    }
+
+    // ============================= K-WAY OPERATIONS =============================
+
+    // Intersects all sets in a single sweep: the cursors leapfrog each
+    // other to the largest lower endpoint, galloping through inputs much
+    // larger than the smallest one.  Stops as soon as any input runs out.
+    template<typename T>
+    set<cunits<T>> intersect_all(span<const set<cunits<T>> *const> sets) {
+        set<cunits<T>> ret;
+
+        if (sets.empty() || ranges::any_of(sets, [](auto s) { return s->empty(); })) {
+            return ret;
         }
 
-        static set<data_type> from_set_of(const set<value_type> &values) {
-            auto vec = vector<value_type>(values.begin(), values.end());
-            auto result = from_vector(vec);
-            return result;
+        using iterator = decltype(sets.front()->begin());
+
+        auto smallest = ranges::min(sets | views::transform([](auto s) { return s->size(); }));
+        vector<iterator> cur;
+        vector<bool> gallop;
+        for (auto s: sets) {
+            cur.push_back(s->begin());
+            gallop.push_back(cunits_detail::skewed(smallest, s->size()));
         }
 
-        vector<value_type> to_vector() const {
-            vector<value_type> result;
-            for (const auto &cu: m_cus) {
-                for (auto value = cu.min(); value < cu.max(); ++value) {
-                    result.push_back(value);
+        auto lo = sets.front()->begin()->min();
+
+        while (true) {
+            // raise lo until every input has an interval covering it
+            for (bool stable = false; !stable;) {
+                stable = true;
+                for (size_t n = 0; n < sets.size(); ++n) {
+                    cur[n] = cunits_detail::seek_past(*sets[n], cur[n], lo, gallop[n]);
+                    if (cur[n] == sets[n]->end()) {
+                        return ret;
+                    }
+                    if (lo < cur[n]->min()) {
+                        lo = cur[n]->min();
+                        stable = false;
+                    }
                 }
             }
-            return result;
+
+            auto hi = ranges::min(cur | views::transform([](auto i) { return i->max(); }));
+            ret.append({lo, hi});
+            lo = hi;
         }
+    }
 
-        set<value_type> to_set_of() const {
-            auto vec = to_vector();
-            set<value_type> result(vec.begin(), vec.end());
-            return result;
+    // Unites all sets in a single sweep, always taking the next interval
+    // from a min-heap of the input cursors.  O(N log k).
+    template<typename T>
+    set<cunits<T>> union_all(span<const set<cunits<T>> *const> sets) {
+        using iterator = decltype(sets.front()->begin());
+        using cursor = pair<iterator, iterator>;
+
+        auto later = [](const cursor &lhs, const cursor &rhs) {
+            return rhs.first->min() < lhs.first->min();
+        };
+
+        vector<cursor> heap;
+        for (auto s: sets) {
+            if (!s->empty()) {
+                heap.emplace_back(s->begin(), s->end());
+            }
         }
+        ranges::make_heap(heap, later);
 
-    };
+        set<cunits<T>> ret;
 
-    // ============================= NON-MEMBER FUNCTIONS =============================
+        while (!heap.empty()) {
+            ranges::pop_heap(heap, later);
+            auto &[i, last] = heap.back();
+            ret.append(*i);
 
-    template<typename T>
-    bool operator==(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs) {
-        return ranges::equal(lhs, rhs);
+            if (++i == last) {
+                heap.pop_back();
+            } else {
+                ranges::push_heap(heap, later);
+            }
+        }
+
+        return ret;
     }
 
+    // Parallel tree reduction for large fan-ins: the halves are reduced
+    // with the given launch policy and joined pairwise.
     template<typename T>
-    bool operator!=(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs) {
-        return !(lhs == rhs);
+    set<cunits<T>> intersect_all(span<const set<cunits<T>> *const> sets, launch policy) {
+        if (sets.size() <= cunits_detail::reduction_leaf) {
+            return intersect_all(sets);
+        }
+
+        auto half = sets.size() / 2;
+        auto lhs = async(policy, [=] { return intersect_all(sets.first(half), policy); });
+        auto rhs = intersect_all(sets.subspan(half), policy);
+
+        return intersection(lhs.get(), rhs);
     }
 
     template<typename T>
-    ostream &operator<<(ostream &os, const set<cunits<T>> &cus) {
-        os << "{";
-        for (auto it = cus.begin(); it != cus.end(); ++it) {
-            os << *it;
-            if (next(it) != cus.end()) {
-                os << ", ";
-            }
+    set<cunits<T>> union_all(span<const set<cunits<T>> *const> sets, launch policy) {
+        if (sets.size() <= cunits_detail::reduction_leaf) {
+            return union_all(sets);
         }
-        os << "}";
-        return os;
+
+        auto half = sets.size() / 2;
+        auto lhs = async(policy, [=] { return union_all(sets.first(half), policy); });
+        auto rhs = union_all(sets.subspan(half), policy);
+
+        return union_of(lhs.get(), rhs);
     }
 
+    // Tests one candidate against many supersets, writing whether each of
+    // them includes it.  The candidate's bounds are computed once and
+    // reject most supersets before any merge walk.  Returns the number of
+    // supersets including the candidate.
     template<typename T>
-    istream &operator>>(istream &is, set<cunits<T>> &cus) {
-        char c;
+    size_t included_in(const set<cunits<T>> &candidate, span<const set<cunits<type_identity_t<T>>> *const> supersets,
+                       span<bool> result) {
+        assert(result.size() == supersets.size());
 
-        is >> c;
-        assert(!is.fail() && c == '{');
+        if (candidate.empty()) {
+            ranges::fill(result, true);
+            return result.size();
+        }
 
-        for (cunits<T> cu; is >> cu;) {
-            cus.insert(cu);
-            is >> c;
-            if (c == '}') {
-                break;
-            }
+        auto min = candidate.begin()->min();
+        auto max = prev(candidate.end())->max();
+        size_t count = 0;
+
+        for (size_t n = 0; n < supersets.size(); ++n) {
+            const auto &s = *supersets[n];
+            result[n] = !s.empty() && s.begin()->min() <= min && max <= prev(s.end())->max() && s.includes(candidate);
+            count += result[n];
         }
 
-        return is;
+        return count;
     }
 
     template<typename T>
-    set<cunits<T>> intersection(const set<cunits<T>> &lhs, const set<cunits<T>> &rhs) {
-        set<cunits<T>> ret;
+    set<cunits<T>> intersect_all(initializer_list<const set<cunits<T>> *> sets) {
+        return intersect_all(span(sets.begin(), sets.size()));
+    }
 
-        auto i = lhs.begin();
-        auto j = rhs.begin();
+    template<typename T>
+    set<cunits<T>> union_all(initializer_list<const set<cunits<T>> *> sets) {
+        return union_all(span(sets.begin(), sets.size()));
+    }
 
-        while (i != lhs.end() && j != rhs.end()) {
-            if (i->max() <= j->min()) {
-                ++i;
-                continue;
-            }
+    // ============================= SET EXPRESSIONS =============================
 
-            if (j->max() <= i->min()) {
-                ++j;
-                continue;
-            }
+    namespace cunits_detail {
+        template<typename X>
+        inline constexpr bool is_cunits_set = false;
+
+        template<typename T>
+        inline constexpr bool is_cunits_set<set<cunits<T>>> = true;
+
+        template<typename X>
+        concept operand = is_cunits_set<X> || is_expression<X>;
 
-            auto min = std::max(i->min(), j->min());
-            auto max = std::min(i->max(), j->max());
-            ret.insert({min, max});
+        template<typename X>
+        concept operand_ref = operand<remove_cvref_t<X>>;
 
-            if (i->max() < j->max()) {
-                ++i;
+        template<operand_ref X>
+        auto as_operand(X &&x) {
+            using U = remove_cvref_t<X>;
+            if constexpr (is_expression<U>) {
+                return U(std::forward<X>(x));
+            } else if constexpr (is_lvalue_reference_v<X>) {
+                return set_operand<U>{&x};
             } else {
-                ++j;
+                return owned_set_operand<U>{std::move(x)};
             }
         }
 
-        return ret;
+        template<template<typename, typename> typename Cursor, typename L, typename R>
+        auto make_expression(L &&lhs, R &&rhs) {
+            auto l = as_operand(std::forward<L>(lhs));
+            auto r = as_operand(std::forward<R>(rhs));
+            return expression<Cursor, decltype(l), decltype(r)>(std::move(l), std::move(r));
+        }
     }
 
-    template<typename T>
-    set<cunits<T>> intersection(const cunits<T> &lhs, const set<cunits<T>> &rhs) {
-        return intersection(set<cunits<T>>{lhs}, rhs);
+    // a & b, a | b and a - b build lazy expressions over sets and other
+    // expressions; convert to a set to materialize the result.  Named sets
+    // are referred to, temporaries are moved into the expression.
+
+    template<cunits_detail::operand_ref L, cunits_detail::operand_ref R>
+    auto operator&(L &&lhs, R &&rhs) {
+        return cunits_detail::make_expression<cunits_detail::intersection_cursor>(std::forward<L>(lhs), std::forward<R>(rhs));
     }
 
-    template<typename T>
-    set<cunits<T>> intersection(const set<cunits<T>> &lhs, const cunits<T> &rhs) {
-        return intersection(lhs, set<cunits<T>>{rhs});
+    template<cunits_detail::operand_ref L, cunits_detail::operand_ref R>
+    auto operator|(L &&lhs, R &&rhs) {
+        return cunits_detail::make_expression<cunits_detail::union_cursor>(std::forward<L>(lhs), std::forward<R>(rhs));
     }
 
-    template<typename T>
-    set<cunits<T>> intersection(const cunits<T> &lhs, const cunits<T> &rhs) {
-        return intersection(set<cunits<T>>{lhs}, set<cunits<T>>{rhs});
+    template<cunits_detail::operand_ref L, cunits_detail::operand_ref R>
+    auto operator-(L &&lhs, R &&rhs) {
+        return cunits_detail::make_expression<cunits_detail::difference_cursor>(std::forward<L>(lhs), std::forward<R>(rhs));
     }
 
 }
@@ -29,6 +29,25 @@ TEST(specSetTests, copy_assignment) {
     EXPECT_NE(s_copy.size(), 0);
 }
 
+TEST(specSetTests, move_and_reuse) {
+    std::set<cunits<int>> c;
+    c.insert({0, 10});
+    std::set<cunits<int>> d(std::move(c));
+    EXPECT_EQ(d.cardinality(), 10);
+
+    c.insert({100, 101});
+    EXPECT_EQ(c.size(), 1);
+    EXPECT_EQ(c.cardinality(), 1);
+    EXPECT_EQ(c.count_in_range({0, 200}), 1);
+
+    std::set<cunits<int>> e{{5, 8}};
+    e = std::move(d);
+    EXPECT_EQ(e.cardinality(), 10);
+    d.insert({20, 22});
+    EXPECT_EQ(d.cardinality(), 2);
+    EXPECT_EQ(d.select(0), 20);
+}
+
 TEST(specSetTests, begin) {
     std::set<cunits<int>> s = {{1, 2}, {3, 4}, {5, 6}};
     EXPECT_FALSE(s.empty());
@@ -55,6 +74,47 @@ TEST(specSetTests, insert) {
     EXPECT_EQ(s.size(), 1);
 }
 
+TEST(specSetTests, insert_spanning) {
+    std::set<cunits<int>> s{{0, 2}, {4, 6}, {8, 10}, {12, 14}, {20, 22}};
+    s.enable_gap_index();
+
+    s.insert({1, 13});
+    EXPECT_EQ(s, (std::set<cunits<int>>{{0, 14}, {20, 22}}));
+    EXPECT_EQ(s.cardinality(), 16);
+    EXPECT_EQ(s.find_worst_fit(), (cunits<int>{14, 20}));
+
+    s.insert({14, 20});
+    EXPECT_EQ(s, (std::set<cunits<int>>{{0, 22}}));
+
+    s.insert({5, 7});
+    s.insert({9, 9});
+    EXPECT_EQ(s, (std::set<cunits<int>>{{0, 22}}));
+
+    s.insert({-10, 30});
+    EXPECT_EQ(s, (std::set<cunits<int>>{{-10, 30}}));
+    EXPECT_EQ(s.cardinality(), 40);
+    EXPECT_EQ(s.find_worst_fit(), std::nullopt);
+}
+
+TEST(specSetTests, insert_range) {
+    std::vector<cunits<int>> units{{40, 45}, {3, 5}, {10, 12}, {0, 4}, {11, 20}, {50, 50}, {20, 22}, {60, 61}};
+    std::set<cunits<int>> loaded(units.begin(), units.end());
+    EXPECT_EQ(loaded, (std::set<cunits<int>>{{0, 5}, {10, 22}, {40, 45}, {60, 61}}));
+
+    loaded.insert_range(std::vector<cunits<int>>{{70, 72}, {75, 76}});
+    EXPECT_EQ(loaded.size(), 6);
+    EXPECT_EQ(loaded.cardinality(), 26);
+
+    loaded.enable_gap_index();
+    loaded.insert_range(std::vector<cunits<int>>{{4, 11}, {44, 62}, {-3, -1}});
+    EXPECT_EQ(loaded, (std::set<cunits<int>>{{-3, -1}, {0, 22}, {40, 62}, {70, 72}, {75, 76}}));
+    EXPECT_EQ(loaded.cardinality(), 49);
+    EXPECT_EQ(loaded.find_worst_fit(), (cunits<int>{22, 40}));
+
+    std::set<cunits<int>> overlapping{{5, 9}, {1, 3}, {2, 6}};
+    EXPECT_EQ(overlapping, (std::set<cunits<int>>{{1, 9}}));
+}
+
 TEST(specSetTests, erase_cu) {
     std::set<cunits<int>> s{{1, 6}};
     EXPECT_FALSE(s.empty());
@@ -65,6 +125,61 @@ TEST(specSetTests, erase_cu) {
     EXPECT_EQ(s.size(), 2);
 }
 
+TEST(specSetTests, erase_spanning) {
+    std::set<cunits<int>> s{{0, 5}, {8, 10}, {12, 14}, {20, 30}};
+    s.enable_gap_index();
+
+    s.erase({3, 25});
+    EXPECT_EQ(s, (std::set<cunits<int>>{{0, 3}, {25, 30}}));
+    EXPECT_EQ(s.cardinality(), 8);
+    EXPECT_EQ(s.find_worst_fit(), (cunits<int>{3, 25}));
+
+    s.erase({-5, 1});
+    s.erase({29, 40});
+    s.erase({10, 20});
+    EXPECT_EQ(s, (std::set<cunits<int>>{{1, 3}, {25, 29}}));
+
+    s.erase(27);
+    s.erase(2);
+    s.erase(100);
+    EXPECT_EQ(s, (std::set<cunits<int>>{{1, 2}, {25, 27}, {28, 29}}));
+    EXPECT_EQ(s.cardinality(), 4);
+
+    s.erase({0, 50});
+    EXPECT_TRUE(s.empty());
+    EXPECT_EQ(s.cardinality(), 0);
+}
+
+TEST(specSetTests, erase_if) {
+    std::set<cunits<int>> s{{0, 1}, {2, 6}, {8, 9}, {10, 13}, {20, 21}};
+    s.enable_gap_index();
+
+    EXPECT_EQ(std::erase_if(s, [](const cunits<int> &cu) { return cu.size() == 1; }), 3);
+    EXPECT_EQ(s, (std::set<cunits<int>>{{2, 6}, {10, 13}}));
+    EXPECT_EQ(s.cardinality(), 7);
+    EXPECT_EQ(s.find_worst_fit(), (cunits<int>{6, 10}));
+    EXPECT_EQ(s.erase_if([](const cunits<int> &) { return false; }), 0);
+}
+
+TEST(specSetTests, erase_values) {
+    std::set<cunits<int>> s{{0, 10}, {20, 30}};
+    std::set<cunits<int>> p = s;
+    std::vector<int> values{1, 2, 3, 9, 20, 25, 40};
+
+    s.erase_values(values);
+    EXPECT_EQ(s, (std::set<cunits<int>>{{0, 1}, {4, 9}, {21, 25}, {26, 30}}));
+    EXPECT_EQ(s.cardinality(), 14);
+
+    p.erase_values(values, std::launch::async, 4);
+    EXPECT_EQ(p, s);
+
+    std::vector<int> one{5};
+    s.erase_values(one);
+    EXPECT_EQ(s, (std::set<cunits<int>>{{0, 1}, {4, 5}, {6, 9}, {21, 25}, {26, 30}}));
+    s.erase_values(std::span<const int>());
+    EXPECT_EQ(s.size(), 5);
+}
+
 TEST(specSetTests, erase_iterator) {
     std::set<cunits<int>> s{{1, 2}, {4, 6}, {8, 10}};
     EXPECT_FALSE(s.empty());
@@ -87,6 +202,242 @@ TEST(specSetTests, clear) {
     EXPECT_EQ(s.size(), 0);
 }
 
+TEST(specSetTests, cardinality) {
+    std::set<cunits<int>> s{{1, 2}, {4, 6}, {8, 10}};
+    EXPECT_EQ(s.cardinality(), 5);
+
+    s.insert({2, 4});
+    EXPECT_EQ(s.cardinality(), 7);
+
+    s.erase(cunits(4, 5));
+    EXPECT_EQ(s.cardinality(), 6);
+
+    s.append({9, 14});
+    EXPECT_EQ(s.cardinality(), 10);
+
+    s.clear();
+    EXPECT_EQ(s.cardinality(), 0);
+}
+
+TEST(specSetTests, count_in_range) {
+    std::set<cunits<int>> s{{1, 5}, {10, 15}, {20, 22}};
+    EXPECT_EQ(s.count_in_range({0, 100}), 11);
+    EXPECT_EQ(s.count_in_range({3, 12}), 4);
+    EXPECT_EQ(s.count_in_range({5, 10}), 0);
+    EXPECT_EQ(s.count_in_range({14, 21}), 2);
+
+    s.insert({5, 10});
+    EXPECT_EQ(s.count_in_range({3, 12}), 9);
+    EXPECT_EQ(std::set<cunits<int>>{}.count_in_range({0, 10}), 0);
+}
+
+TEST(specSetTests, coverage_histogram) {
+    std::set<cunits<int>> s{{-5, 3}, {8, 25}, {31, 32}, {60, 70}};
+
+    std::vector<int> buckets(5, -1);
+    s.coverage_histogram({0, 45}, 10, buckets);
+    EXPECT_EQ(buckets, (std::vector<int>{5, 10, 5, 1, 0}));
+
+    buckets.assign(3, -1);
+    s.coverage_histogram({20, 65}, 20, buckets);
+    EXPECT_EQ(buckets, (std::vector<int>{6, 0, 5}));
+
+    std::vector<int> windows(8);
+    s.sliding_coverage(-10, 10, 5, windows);
+    for (size_t q = 0; q < windows.size(); ++q) {
+        int x = -10 + 5 * static_cast<int>(q);
+        EXPECT_EQ(windows[q], s.count_in_range({x, x + 10}));
+    }
+}
+
+TEST(specSetTests, rank_select) {
+    std::set<cunits<int>> s{{1, 5}, {10, 15}, {20, 22}};
+    EXPECT_EQ(s.rank(0), 0);
+    EXPECT_EQ(s.rank(3), 2);
+    EXPECT_EQ(s.rank(7), 4);
+    EXPECT_EQ(s.rank(12), 6);
+    EXPECT_EQ(s.rank(30), 11);
+
+    EXPECT_EQ(s.select(0), 1);
+    EXPECT_EQ(s.select(4), 10);
+    EXPECT_EQ(s.select(9), 20);
+    EXPECT_EQ(s.select(10), 21);
+    for (int k = 0; k < s.cardinality(); ++k) {
+        EXPECT_EQ(s.rank(s.select(k)), k);
+    }
+
+    std::vector<int> values{0, 3, 7, 12, 30};
+    std::vector<int> ranks(values.size());
+    s.rank(values, ranks);
+    EXPECT_EQ(ranks, (std::vector<int>{0, 2, 4, 6, 11}));
+
+    std::vector<int> ks{0, 4, 9, 10};
+    std::vector<int> selected(ks.size());
+    s.select(ks, selected);
+    EXPECT_EQ(selected, (std::vector<int>{1, 10, 20, 21}));
+}
+
+TEST(specSetTests, largest) {
+    std::set<cunits<int>> s{{0, 2}, {5, 9}, {12, 13}, {20, 24}, {30, 31}};
+    using units = std::vector<cunits<int>>;
+
+    EXPECT_EQ(s.largest_intervals(3), (units{{5, 9}, {20, 24}, {0, 2}}));
+    EXPECT_EQ(s.largest_intervals(0), units{});
+    EXPECT_EQ(s.largest_intervals(10).size(), 5);
+
+    for (bool indexed: {false, true}) {
+        if (indexed) {
+            s.enable_gap_index();
+        }
+        EXPECT_EQ(s.largest_gaps(2, {0, 31}), (units{{13, 20}, {24, 30}}));
+        EXPECT_EQ(s.largest_gaps(3, {-10, 40}), (units{{-10, 0}, {31, 40}, {13, 20}}));
+        EXPECT_EQ(s.largest_gaps(2, {1, 16}), (units{{2, 5}, {9, 12}}));
+        EXPECT_EQ(s.largest_gaps(5, {6, 8}), units{});
+        EXPECT_EQ(s.largest_gaps(1, {22, 29}), (units{{24, 29}}));
+    }
+}
+
+TEST(specSetTests, sampling) {
+    std::set<cunits<int>> s{{0, 2}, {10, 12}, {14, 18}, {100, 101}};
+    std::mt19937 rng(7);
+
+    std::vector<int> hits(101);
+    for (int i = 0; i < 9000; ++i) {
+        hits[s.sample_value(rng)]++;
+    }
+    for (int value = 0; value < 101; ++value) {
+        if (s.contains(value)) {
+            EXPECT_NEAR(hits[value], 1000, 200);
+        } else {
+            EXPECT_EQ(hits[value], 0);
+        }
+    }
+
+    std::vector<int> values(50);
+    s.sample_values(rng, values);
+    EXPECT_TRUE(std::ranges::is_sorted(values));
+    EXPECT_TRUE(std::ranges::all_of(values, [&](int v) { return s.contains(v); }));
+
+    std::vector<int> gaps(101);
+    for (int i = 0; i < 6000; ++i) {
+        auto gap = s.sample_gap(rng, 1);
+        ASSERT_TRUE(gap.has_value());
+        EXPECT_EQ(s.count_in_range(*gap), 0);
+        gaps[gap->min()]++;
+    }
+    EXPECT_NEAR(gaps[2], 6000 * 8 / 92, 150);
+    EXPECT_NEAR(gaps[12], 6000 * 2 / 92, 100);
+    EXPECT_NEAR(gaps[18], 6000 * 82 / 92, 150);
+
+    EXPECT_EQ(s.sample_gap(rng, 9), (cunits<int>{18, 100}));
+    EXPECT_EQ(s.sample_gap(rng, 83), std::nullopt);
+    EXPECT_EQ(std::set<cunits<int>>{}.sample_gap(rng, 1), std::nullopt);
+}
+
+TEST(specSetTests, find_gap) {
+    std::set<cunits<int>> s{{0, 5}, {8, 10}, {14, 20}, {23, 30}};
+    cunits<int> universe(0, 40);
+
+    EXPECT_EQ(s.find_first_gap(3, universe), cunits(5, 8));
+    EXPECT_EQ(s.find_first_gap(4, universe), cunits(10, 14));
+    EXPECT_EQ(s.find_first_gap(5, universe), cunits(30, 35));
+    EXPECT_EQ(s.find_first_gap(11, universe), std::nullopt);
+    EXPECT_EQ(s.find_first_gap(2, {2, 22}), cunits(5, 7));
+    EXPECT_EQ(s.find_first_gap(3, {6, 40}), cunits(10, 13));
+    EXPECT_EQ(s.find_first_gap(3, universe, 12), cunits(20, 23));
+
+    EXPECT_EQ(s.find_last_gap(3, universe), cunits(37, 40));
+    EXPECT_EQ(s.find_last_gap(3, {0, 30}), cunits(20, 23));
+    EXPECT_EQ(s.find_last_gap(4, {0, 30}), cunits(10, 14));
+    EXPECT_EQ(s.find_last_gap(3, {-5, 26}), cunits(20, 23));
+    EXPECT_EQ(s.find_last_gap(4, {0, 13}), std::nullopt);
+
+    EXPECT_EQ(std::set<cunits<int>>{}.find_first_gap(4, universe), cunits(0, 4));
+    EXPECT_EQ(std::set<cunits<int>>{}.find_last_gap(4, universe), cunits(36, 40));
+}
+
+TEST(specSetTests, best_worst_fit) {
+    std::set<cunits<int>> s{{0, 5}, {8, 10}, {14, 20}, {23, 30}, {33, 40}};
+
+    for (int indexed = 0; indexed < 2; ++indexed) {
+        if (indexed) {
+            s.enable_gap_index();
+        }
+
+        EXPECT_EQ(s.find_best_fit(1), cunits(5, 8));
+        EXPECT_EQ(s.find_best_fit(4), cunits(10, 14));
+        EXPECT_EQ(s.find_best_fit(5), std::nullopt);
+        EXPECT_EQ(s.find_worst_fit(), cunits(10, 14));
+    }
+
+    s.insert({10, 12});
+    s.erase(cunits(35, 37));
+    s.append({45, 50});
+    EXPECT_EQ(s.find_best_fit(2), cunits(12, 14));
+    EXPECT_EQ(s.find_best_fit(3), cunits(5, 8));
+    EXPECT_EQ(s.find_worst_fit(), cunits(40, 45));
+
+    s.disable_gap_index();
+    EXPECT_EQ(s.find_best_fit(3), cunits(5, 8));
+    EXPECT_EQ((std::set<cunits<int>>{{1, 2}}.find_worst_fit()), std::nullopt);
+}
+
+TEST(specSetTests, navigation) {
+    std::set<cunits<int>> s{{1, 5}, {10, 15}, {20, 22}};
+
+    EXPECT_EQ(s.next_covered(0), 1);
+    EXPECT_EQ(s.next_covered(3), 3);
+    EXPECT_EQ(s.next_covered(5), 10);
+    EXPECT_EQ(s.next_covered(22), std::nullopt);
+
+    EXPECT_EQ(s.prev_covered(0), std::nullopt);
+    EXPECT_EQ(s.prev_covered(3), 3);
+    EXPECT_EQ(s.prev_covered(7), 4);
+    EXPECT_EQ(s.prev_covered(30), 21);
+
+    EXPECT_EQ(s.next_gap(0), cunits(0, 1));
+    EXPECT_EQ(s.next_gap(3), cunits(5, 10));
+    EXPECT_EQ(s.next_gap(7), cunits(7, 10));
+    EXPECT_EQ(s.next_gap(21), cunits(22, std::numeric_limits<int>::max()));
+
+    EXPECT_EQ(s.run_end(3), 5);
+    EXPECT_EQ(s.run_end(5), std::nullopt);
+    EXPECT_EQ(s.run_end(14), 15);
+
+    std::vector<int> xs{0, 3, 7, 14, 30};
+    std::vector<std::optional<int>> next(xs.size()), prev(xs.size()), ends(xs.size());
+    std::vector<cunits<int>> gaps(xs.size());
+    s.next_covered(xs, next);
+    s.prev_covered(xs, prev);
+    s.run_end(xs, ends);
+    s.next_gap(xs, gaps);
+    for (size_t q = 0; q < xs.size(); ++q) {
+        EXPECT_EQ(next[q], s.next_covered(xs[q]));
+        EXPECT_EQ(prev[q], s.prev_covered(xs[q]));
+        EXPECT_EQ(ends[q], s.run_end(xs[q]));
+        EXPECT_EQ(gaps[q], s.next_gap(xs[q]));
+    }
+}
+
+TEST(specSetTests, overlapping) {
+    std::set<cunits<int>> s{{1, 5}, {10, 15}, {20, 22}, {30, 35}};
+
+    auto hits = s.overlapping({4, 21});
+    EXPECT_EQ(std::ranges::distance(hits), 3);
+    EXPECT_EQ(*hits.begin(), cunits(1, 5));
+
+    std::vector<cunits<int>> clipped;
+    for (const auto &cu: s.clipped({4, 21})) {
+        clipped.push_back(cu);
+    }
+    EXPECT_EQ(clipped, (std::vector<cunits<int>>{{4, 5}, {10, 15}, {20, 21}}));
+
+    EXPECT_TRUE(s.overlapping({5, 10}).empty());
+    EXPECT_TRUE(s.overlapping({12, 12}).empty());
+    EXPECT_EQ(std::ranges::distance(s.overlapping({15, 21})), 1);
+    EXPECT_EQ(std::ranges::distance(s.overlapping({0, 100})), 4);
+}
+
 TEST(specSetTests, inlcudes_cunit) {
     std::set<cunits<int>> s{{1, 2}, {4, 6}, {8, 10}};
     EXPECT_FALSE(s.empty());
@@ -126,6 +477,25 @@ TEST(specSetTests, inlcudes_base_type) {
     EXPECT_FALSE(s.includes(s7));
 }
 
+TEST(specSetTests, included_in) {
+    std::set<cunits<int>> candidate{{4, 5}, {8, 9}};
+
+    std::set<cunits<int>> s1{{1, 2}, {4, 6}, {8, 10}};
+    std::set<cunits<int>> s2{{4, 6}};
+    std::set<cunits<int>> s3{{0, 20}};
+    std::set<cunits<int>> s4{};
+    std::vector<const std::set<cunits<int>> *> supersets{&s1, &s2, &s3, &s4};
+
+    bool result[4];
+    EXPECT_EQ(std::included_in(candidate, supersets, result), 2);
+    EXPECT_TRUE(result[0]);
+    EXPECT_FALSE(result[1]);
+    EXPECT_TRUE(result[2]);
+    EXPECT_FALSE(result[3]);
+
+    EXPECT_EQ(std::included_in(std::set<cunits<int>>{}, supersets, result), 4);
+}
+
 TEST(specSetTests, equals_operator) {
     std::set<cunits<int>> s{{1, 2}, {4, 6}, {8, 10}};
     EXPECT_FALSE(s.empty());
@@ -250,6 +620,220 @@ TEST(specSetTests, cunit_cunit_intersection) {
     EXPECT_EQ(result, std::set<cunits<int>>{});
 }
 
+TEST(specSetTests, set_set_union) {
+    std::set<cunits<int>> s1{{1, 3}, {6, 8}, {12, 14}};
+    std::set<cunits<int>> s2{{2, 4}, {8, 10}, {20, 22}};
+    std::set<cunits<int>> expected{{1, 4}, {6, 10}, {12, 14}, {20, 22}};
+
+    EXPECT_EQ(std::union_of(s1, s2), expected);
+    EXPECT_EQ(std::union_of(s2, s1), expected);
+    EXPECT_EQ(std::union_of(s1, s1), s1);
+    EXPECT_EQ(std::union_of(s1, std::set<cunits<int>>{}), s1);
+    EXPECT_EQ(std::union_of(std::set<cunits<int>>{}, s1), s1);
+}
+
+TEST(specSetTests, set_set_difference) {
+    std::set<cunits<int>> s1{{1, 10}, {12, 20}};
+    std::set<cunits<int>> s2{{0, 2}, {4, 5}, {9, 13}, {15, 16}};
+    std::set<cunits<int>> expected1{{2, 4}, {5, 9}, {13, 15}, {16, 20}};
+    std::set<cunits<int>> expected2{{0, 1}, {10, 12}};
+
+    EXPECT_EQ(std::difference(s1, s2), expected1);
+    EXPECT_EQ(std::difference(s2, s1), expected2);
+    EXPECT_EQ(std::difference(s1, s1), std::set<cunits<int>>{});
+    EXPECT_EQ(std::difference(s1, std::set<cunits<int>>{}), s1);
+    EXPECT_EQ(std::difference(std::set<cunits<int>>{}, s1), std::set<cunits<int>>{});
+}
+
+TEST(specSetTests, skewed_set_algebra) {
+    std::set<cunits<int>> large;
+    for (int i = 0; i < 1000; ++i) {
+        large.insert({i * 10, i * 10 + 5});
+    }
+    std::set<cunits<int>> small{{-3, 2}, {103, 127}, {5000, 5001}, {9993, 10010}};
+
+    auto large_values = large.to_set_of();
+    auto small_values = small.to_set_of();
+    std::vector<int> expected;
+
+    std::ranges::set_intersection(large_values, small_values, std::back_inserter(expected));
+    EXPECT_EQ(std::intersection(large, small).to_vector(), expected);
+    EXPECT_EQ(std::intersection(small, large).to_vector(), expected);
+
+    expected.clear();
+    std::ranges::set_union(large_values, small_values, std::back_inserter(expected));
+    EXPECT_EQ(std::union_of(large, small).to_vector(), expected);
+    EXPECT_EQ(std::union_of(small, large).to_vector(), expected);
+
+    expected.clear();
+    std::ranges::set_difference(large_values, small_values, std::back_inserter(expected));
+    EXPECT_EQ(std::difference(large, small).to_vector(), expected);
+
+    expected.clear();
+    std::ranges::set_difference(small_values, large_values, std::back_inserter(expected));
+    EXPECT_EQ(std::difference(small, large).to_vector(), expected);
+
+    EXPECT_TRUE(large.includes(std::set<cunits<int>>{{10, 12}, {5000, 5005}}));
+    EXPECT_FALSE(large.includes(std::set<cunits<int>>{{10, 12}, {5000, 5006}}));
+}
+
+TEST(specSetTests, overlaps) {
+    std::set<cunits<int>> s1{{1, 5}, {10, 15}};
+    std::set<cunits<int>> s2{{5, 10}, {15, 20}};
+    std::set<cunits<int>> s3{{14, 16}};
+
+    EXPECT_FALSE(std::overlaps(s1, s2));
+    EXPECT_TRUE(std::overlaps(s1, s3));
+    EXPECT_TRUE(std::overlaps(s3, s2));
+    EXPECT_FALSE(std::overlaps(s1, std::set<cunits<int>>{}));
+}
+
+TEST(specSetTests, measures) {
+    std::set<cunits<int>> s1{{1, 5}, {10, 15}};
+    std::set<cunits<int>> s2{{3, 12}, {20, 22}};
+
+    EXPECT_EQ(std::intersection_measure(s1, s2), 4);
+    EXPECT_EQ(std::intersection_measure(s2, s1), 4);
+    EXPECT_EQ(std::union_measure(s1, s2), 16);
+    EXPECT_DOUBLE_EQ(std::jaccard(s1, s2), 0.25);
+    EXPECT_DOUBLE_EQ(std::jaccard(s1, s1), 1.0);
+    EXPECT_DOUBLE_EQ(std::jaccard(s1, std::set<cunits<int>>{}), 0.0);
+    EXPECT_DOUBLE_EQ(std::jaccard(std::set<cunits<int>>{}, std::set<cunits<int>>{}), 1.0);
+}
+
+TEST(specSetTests, parallel_set_algebra) {
+    std::set<cunits<int>> s1;
+    std::set<cunits<int>> s2;
+    for (int i = 0; i < 100000; ++i) {
+        s1.append({i * 10, i * 10 + 6});
+        s2.append({i * 7 + 3, i * 7 + 5});
+    }
+
+    EXPECT_EQ(std::intersection(s1, s2, std::launch::async, 4), std::intersection(s1, s2));
+    EXPECT_EQ(std::union_of(s1, s2, std::launch::async, 4), std::union_of(s1, s2));
+    EXPECT_EQ(std::difference(s1, s2, std::launch::async, 4), std::difference(s1, s2));
+    EXPECT_EQ(std::difference(s2, s1, std::launch::async, 4), std::difference(s2, s1));
+
+    std::set<cunits<int>> small{{5, 50}, {400000, 400100}};
+    EXPECT_EQ(std::intersection(s1, small, std::launch::async, 4), std::intersection(s1, small));
+    EXPECT_EQ(std::difference(s1, small, std::launch::async, 4), std::difference(s1, small));
+
+    auto both = std::intersection(s1, s2, std::launch::async, 4);
+    EXPECT_EQ(both.cardinality(), std::intersection(s1, s2).cardinality());
+
+    // one interval, cut at every seam and stitched back together
+    std::set<cunits<int>> gaps;
+    for (int i = 0; i < 100000; ++i) {
+        gaps.append({i * 10 + 6, i * 10 + 10});
+    }
+    auto whole = std::union_of(s1, gaps, std::launch::async, 4);
+    EXPECT_EQ(whole, (std::set<cunits<int>>{{0, 1000000}}));
+    EXPECT_EQ(whole.cardinality(), 1000000);
+}
+
+TEST(specSetTests, intersect_all) {
+    std::set<cunits<int>> s1{{1, 10}, {20, 30}};
+    std::set<cunits<int>> s2{{5, 25}, {28, 40}};
+    std::set<cunits<int>> s3{{0, 8}, {9, 29}};
+    std::set<cunits<int>> expected{{5, 8}, {9, 10}, {20, 25}, {28, 29}};
+
+    EXPECT_EQ(std::intersect_all({&s1, &s2, &s3}), expected);
+    EXPECT_EQ(std::intersect_all({&s1}), s1);
+
+    std::set<cunits<int>> empty{};
+    EXPECT_EQ(std::intersect_all({&s1, &empty, &s2}), empty);
+
+    std::vector<const std::set<cunits<int>> *> none;
+    EXPECT_EQ(std::intersect_all<int>(none), empty);
+}
+
+TEST(specSetTests, union_all) {
+    std::set<cunits<int>> s1{{1, 3}, {20, 30}};
+    std::set<cunits<int>> s2{{3, 5}, {40, 50}};
+    std::set<cunits<int>> s3{{7, 8}, {25, 41}};
+    std::set<cunits<int>> expected{{1, 5}, {7, 8}, {20, 50}};
+
+    EXPECT_EQ(std::union_all({&s1, &s2, &s3}), expected);
+    EXPECT_EQ(std::union_all({&s1}), s1);
+
+    std::vector<const std::set<cunits<int>> *> none;
+    EXPECT_EQ(std::union_all<int>(none), std::set<cunits<int>>{});
+}
+
+TEST(specSetTests, k_way_parallel_reduction) {
+    std::vector<std::set<cunits<int>>> sets(40);
+    for (int n = 0; n < 40; ++n) {
+        for (int i = 0; i < 100; ++i) {
+            sets[n].insert({i * 50 + n, i * 50 + n + 30});
+        }
+    }
+
+    std::vector<const std::set<cunits<int>> *> ptrs;
+    auto expected_intersection = sets[0];
+    auto expected_union = sets[0];
+    for (const auto &s: sets) {
+        ptrs.push_back(&s);
+        expected_intersection = std::intersection(expected_intersection, s);
+        expected_union = std::union_of(expected_union, s);
+    }
+
+    EXPECT_EQ(std::intersect_all<int>(ptrs), expected_intersection);
+    EXPECT_EQ(std::intersect_all<int>(ptrs, std::launch::async), expected_intersection);
+    EXPECT_EQ(std::union_all<int>(ptrs), expected_union);
+    EXPECT_EQ(std::union_all<int>(ptrs, std::launch::async), expected_union);
+}
+
+TEST(specSetTests, lazy_expressions) {
+    std::set<cunits<int>> a{{1, 10}, {20, 30}};
+    std::set<cunits<int>> b{{5, 25}, {28, 40}};
+    std::set<cunits<int>> c{{0, 8}, {9, 29}};
+    std::set<cunits<int>> d{{6, 7}, {21, 22}};
+
+    std::set<cunits<int>> result = (a & b & c) - d;
+    std::set<cunits<int>> expected{{5, 6}, {7, 8}, {9, 10}, {20, 21}, {22, 25}, {28, 29}};
+    EXPECT_EQ(result, expected);
+
+    result = a | b | d;
+    EXPECT_EQ(result, std::union_of(std::union_of(a, b), d));
+
+    result = a - (b | c);
+    EXPECT_EQ(result, std::difference(a, std::union_of(b, c)));
+
+    auto expression = (a & b & c) - d;
+    EXPECT_FALSE(expression.empty());
+    EXPECT_EQ(expression.size(), 6);
+    EXPECT_TRUE(expression.contains(5));
+    EXPECT_FALSE(expression.contains(6));
+    EXPECT_TRUE(expression.contains(cunits(22, 25)));
+    EXPECT_FALSE(expression.contains(cunits(20, 22)));
+
+    std::vector<cunits<int>> units;
+    for (auto cu: expression) {
+        units.push_back(cu);
+    }
+    EXPECT_EQ(units.size(), 6);
+    EXPECT_EQ(units.front(), cunits(5, 6));
+
+    EXPECT_TRUE((a & d & c & std::set<cunits<int>>{{100, 200}}).empty());
+}
+
+TEST(specSetTests, lazy_expressions_own_temporaries) {
+    std::set<cunits<int>> a{{1, 10}, {20, 30}};
+
+    // the temporaries die here, the expressions keep their own copies
+    auto e = a & std::set<cunits<int>>{{5, 25}};
+    auto f = std::set<cunits<int>>{{0, 3}} | (std::set<cunits<int>>{{8, 21}} - a);
+    EXPECT_EQ(e.size(), 2);
+
+    std::set<cunits<int>> result = e;
+    std::set<cunits<int>> expected{{5, 10}, {20, 25}};
+    EXPECT_EQ(result, expected);
+
+    result = f;
+    expected = {{0, 3}, {10, 20}};
+    EXPECT_EQ(result, expected);
+}
+
 TEST(specSetTests, find_cunit) {
     std::set<cunits<int>> s{{1, 2},
                             {4, 6},
@@ -318,6 +902,170 @@ TEST(specSetTests, contains_value) {
     EXPECT_FALSE(s.contains(6));
 }
 
+TEST(specSetTests, find_batch) {
+    std::set<cunits<int>> s{{1, 5}, {10, 15}, {20, 22}};
+    std::vector<int> values{0, 1, 4, 5, 12, 15, 21, 40};
+
+    std::vector<decltype(s.end())> found(values.size());
+    s.find_batch(values, found);
+    for (size_t q = 0; q < values.size(); ++q) {
+        EXPECT_EQ(found[q], s.find(values[q]));
+    }
+
+    uint64_t bits[1];
+    s.find_batch(values, bits);
+    EXPECT_EQ(bits[0], 0b01010110u);
+}
+
+TEST(specSetTests, find_many) {
+    std::set<cunits<int>> s;
+    for (int i = 0; i < 1000; ++i) {
+        s.append({i * 10, i * 10 + 4});
+    }
+
+    std::vector<int> values;
+    for (int i = 0; i < 100; ++i) {
+        values.push_back((i * 7919) % 10050 - 20);
+    }
+
+    std::vector<decltype(s.end())> found(values.size());
+    s.find_many(values, found);
+    for (size_t q = 0; q < values.size(); ++q) {
+        EXPECT_EQ(found[q], s.find(values[q]));
+    }
+
+    std::set<cunits<int>> empty;
+    std::vector<decltype(empty.end())> none(values.size());
+    empty.find_many(values, none);
+    EXPECT_EQ(std::ranges::count(none, empty.end()), static_cast<std::ptrdiff_t>(values.size()));
+}
+
+TEST(specSetTests, presence_summary) {
+    std::set<cunits<int>> s{{-40, -30}, {0, 5}, {100, 300}, {1000, 1001}};
+    s.enable_summary(4);
+
+    for (int x = -50; x < 1100; ++x) {
+        auto found = s.find(x);
+        EXPECT_EQ(found != s.end(), (x >= -40 && x < -30) || (x >= 0 && x < 5) || (x >= 100 && x < 300) || x == 1000);
+    }
+
+    s.erase({100, 300});
+    s.erase({0, 5});
+    EXPECT_FALSE(s.contains(120));
+    EXPECT_FALSE(s.contains(3));
+    s.insert({2000, 2010});
+    s.insert({-200, -190});
+    s.erase({1000, 1001});
+    EXPECT_TRUE(s.contains(2005));
+    EXPECT_TRUE(s.contains(-195));
+    EXPECT_TRUE(s.contains(-35));
+    EXPECT_FALSE(s.contains(1000));
+    EXPECT_TRUE(s.contains(cunits<int>{-38, -31}));
+    EXPECT_FALSE(s.contains(cunits<int>{1000, 1001}));
+
+    s.clear();
+    EXPECT_FALSE(s.contains(2005));
+    s.append({7, 9});
+    EXPECT_TRUE(s.contains(8));
+
+    std::set<cunits<double>> d{{0.5, 2.5}, {40.0, 41.0}};
+    d.enable_summary(3);
+    EXPECT_TRUE(d.contains(1.0));
+    EXPECT_FALSE(d.contains(20.0));
+    d.erase({40.0, 41.0});
+    EXPECT_FALSE(d.contains(40.0));
+}
+
+TEST(specSetTests, finger_search) {
+    std::set<cunits<int>> s, expected;
+    s.enable_finger();
+    for (int i = 0; i < 200; ++i) {
+        s.insert({i * 10, i * 10 + 4});
+        expected.append({i * 10, i * 10 + 4});
+    }
+    EXPECT_EQ(s, expected);
+
+    for (int x = -5; x < 2010; x += 3) {
+        auto found = s.find(x);
+        EXPECT_EQ(found == s.end(), x < 0 || x >= 1994 || x % 10 >= 4);
+    }
+    for (int x = 2010; x > -5; x -= 7) {
+        auto found = s.find(x);
+        ASSERT_EQ(found == s.end(), expected.find(x) == expected.end());
+        if (found != s.end()) {
+            EXPECT_EQ(*found, *expected.find(x));
+        }
+    }
+
+    s.erase({50, 52});
+    s.erase({1000, 1004});
+    s.insert({4, 10});
+    EXPECT_EQ(s.size(), 198);
+    EXPECT_EQ(*s.find(7), (cunits<int>{0, 14}));
+    EXPECT_EQ(s.find(51), s.end());
+
+    auto hint = s.find(300);
+    EXPECT_EQ(s.find(hint, 1990), s.find(1990));
+    EXPECT_EQ(s.find(hint, 2), s.find(2));
+    EXPECT_EQ(s.find(s.end(), 15), s.end());
+    EXPECT_EQ(*s.insert(hint, {314, 316}), (cunits<int>{310, 316}));
+    EXPECT_EQ(*s.insert(s.end(), {14, 17}), (cunits<int>{0, 17}));
+
+    s.disable_finger();
+    EXPECT_EQ(*s.find(315), (cunits<int>{310, 316}));
+}
+
+TEST(specSetTests, concurrent_finger_lookups) {
+    std::set<cunits<int>> s;
+    for (int i = 0; i < 10000; ++i) {
+        s.append({i * 10, i * 10 + 5});
+    }
+    s.enable_finger();
+
+    // every thread moves the shared finger while the others search from it
+    const auto &shared = s;
+    std::vector<std::future<int>> found;
+    for (int t = 0; t < 4; ++t) {
+        found.push_back(std::async(std::launch::async, [&shared, t] {
+            int hits = 0;
+            for (int v = t; v < 100000; v += 4) {
+                hits += shared.find(v) != shared.end();
+            }
+            return hits;
+        }));
+    }
+
+    int hits = 0;
+    for (auto &f: found) {
+        hits += f.get();
+    }
+    EXPECT_EQ(hits, 50000);
+}
+
+TEST(specSetTests, contains_many) {
+    std::set<cunits<int>> s;
+    for (int i = 0; i < 500; ++i) {
+        s.append({i * 10, i * 10 + 1 + i % 7});
+    }
+
+    std::vector<int> values;
+    for (int i = 0; i < 150; ++i) {
+        values.push_back((i * 7919) % 5100 - 30);
+    }
+
+    std::vector<uint64_t> bits((values.size() + 63) / 64, ~uint64_t{0});
+    s.contains_many(values, bits);
+    for (size_t q = 0; q < values.size(); ++q) {
+        EXPECT_EQ(bits[q / 64] >> q % 64 & 1, s.contains(values[q]));
+    }
+
+    std::ranges::sort(values);
+    s.contains_many(values, bits);
+    for (size_t q = 0; q < values.size(); ++q) {
+        EXPECT_EQ(bits[q / 64] >> q % 64 & 1, s.contains(values[q]));
+    }
+}
+
 TEST(specSetTests, from_vector_to_set) {
 
     std::vector<int> v{1, 2, 3, 4, 6, 7, 8, 12, 14, 15, 16, 17, 18, 19, 20};